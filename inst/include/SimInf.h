@@ -31,6 +31,21 @@
 #define SIMINF_STR(name) #name
 #define SIMINF_CALLDEF(name, n) {SIMINF_STR(name), (DL_FUNC) &name, n}
 
+/* Compile a function in several instruction set variants, where the
+ * variant for the CPU is selected when the shared object is loaded.
+ * Requires a compiler and a C library with support for indirect
+ * functions. Define 'SIMINF_NO_TARGET_CLONES' to disable. */
+#if !defined(SIMINF_NO_TARGET_CLONES) && defined(__x86_64__) && \
+    defined(__GLIBC__) && defined(__has_attribute)
+#  if __has_attribute(target_clones)
+#    define SIMINF_TARGET_CLONES \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#  endif
+#endif
+#if !defined(SIMINF_TARGET_CLONES)
+#  define SIMINF_TARGET_CLONES
+#endif
+
 /* Error constants */
 typedef enum {
     SIMINF_ERR_NEGATIVE_STATE       = -1,
@@ -48,7 +63,13 @@ typedef enum {
     SIMINF_ERR_EVENTS_N             = -15,
     SIMINF_ERR_EVENT_SHIFT          = -16,
     SIMINF_ERR_SHIFT_OUT_OF_BOUNDS  = -17,
-    SIMINF_ERR_INVALID_PROPORTION   = -18
+    SIMINF_ERR_INVALID_PROPORTION   = -18,
+    SIMINF_ERR_INVALID_GROUPS       = -19,
+    SIMINF_ERR_INVALID_SENTINEL     = -20,
+    SIMINF_ERR_INVALID_TRACE        = -21,
+    SIMINF_ERR_INVALID_PFILTER      = -22,
+    SIMINF_ERR_INVALID_PROBE        = -23,
+    SIMINF_ERR_PFILTER_SOLVER       = -24
 } SimInf_error_code;
 
 /* Forward declaration of the transition rate function. */
@@ -77,12 +77,504 @@ static void SimInf_raise_error(int error)
     case SIMINF_ERR_INVALID_PROPORTION:
         Rf_error("Invalid proportion detected (< 0.0 or > 1.0).");
         break;
+    case SIMINF_ERR_INVALID_GROUPS:
+        Rf_error("Invalid 'groups' solver setting.");
+        break;
+    case SIMINF_ERR_INVALID_SENTINEL:
+        Rf_error("Invalid 'sentinel' solver setting.");
+        break;
+    case SIMINF_ERR_INVALID_TRACE:
+        Rf_error("Invalid 'trace' solver setting.");
+        break;
+    case SIMINF_ERR_INVALID_PFILTER:
+        Rf_error("Invalid 'pfilter' solver setting.");
+        break;
+    case SIMINF_ERR_INVALID_PROBE:
+        Rf_error("Invalid 'probe' solver setting.");
+        break;
+    case SIMINF_ERR_PFILTER_SOLVER:
+        Rf_error("The 'pfilter' solver setting requires the 'ssm' solver.");
+        break;
     default:                                        /* #nocov */
         Rf_error("Unknown error code: %i.", error); /* #nocov */
         break;
     }
 }
 
+/**
+ * Create a list with the log of event outcomes.
+ *
+ * @param args Structure with the merged log of event outcomes.
+ * @return a list with the integer vectors 'event' (one-based index
+ *         of the scheduled event), 'time' (when the event was
+ *         processed), 'node' (one-based), 'compartment' (one-based)
+ *         and 'n' (the number of sampled individuals).
+ */
+static SEXP SimInf_event_outcomes(const SimInf_solver_args *args)
+{
+    SEXP result, names;
+    int *event, *time, *node, *compartment, *n;
+    size_t i;
+
+    PROTECT(result = Rf_allocVector(VECSXP, 5));
+    for (i = 0; i < 5; i++)
+        SET_VECTOR_ELT(result, i, Rf_allocVector(INTSXP, args->n_outcomes));
+    PROTECT(names = Rf_allocVector(STRSXP, 5));
+    SET_STRING_ELT(names, 0, Rf_mkChar("event"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("time"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("node"));
+    SET_STRING_ELT(names, 3, Rf_mkChar("compartment"));
+    SET_STRING_ELT(names, 4, Rf_mkChar("n"));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+
+    event = INTEGER(VECTOR_ELT(result, 0));
+    time = INTEGER(VECTOR_ELT(result, 1));
+    node = INTEGER(VECTOR_ELT(result, 2));
+    compartment = INTEGER(VECTOR_ELT(result, 3));
+    n = INTEGER(VECTOR_ELT(result, 4));
+    for (i = 0; i < args->n_outcomes; i++) {
+        event[i] = args->outcomes[i].id + 1;
+        time[i] = args->outcomes[i].time;
+        node[i] = args->outcomes[i].node + 1;
+        compartment[i] = args->outcomes[i].compartment + 1;
+        n[i] = args->outcomes[i].n;
+    }
+
+    UNPROTECT(2);
+
+    return result;
+}
+
+/**
+ * Create a list with the transitions in the sentinel nodes.
+ *
+ * @param args Structure with the merged transition records.
+ * @return a list with the vectors 'time', 'node' (one-based) and
+ *         'transition' (one-based).
+ */
+static SEXP SimInf_transitions(const SimInf_solver_args *args)
+{
+    SEXP result, names;
+    double *time;
+    int *node, *transition;
+    size_t i;
+
+    PROTECT(result = Rf_allocVector(VECSXP, 3));
+    SET_VECTOR_ELT(result, 0, Rf_allocVector(REALSXP, args->n_transitions));
+    SET_VECTOR_ELT(result, 1, Rf_allocVector(INTSXP, args->n_transitions));
+    SET_VECTOR_ELT(result, 2, Rf_allocVector(INTSXP, args->n_transitions));
+    PROTECT(names = Rf_allocVector(STRSXP, 3));
+    SET_STRING_ELT(names, 0, Rf_mkChar("time"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("node"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("transition"));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+
+    time = REAL(VECTOR_ELT(result, 0));
+    node = INTEGER(VECTOR_ELT(result, 1));
+    transition = INTEGER(VECTOR_ELT(result, 2));
+    for (i = 0; i < args->n_transitions; i++) {
+        time[i] = args->transitions[i].time;
+        node[i] = args->transitions[i].node + 1;
+        transition[i] = args->transitions[i].transition + 1;
+    }
+
+    UNPROTECT(2);
+
+    return result;
+}
+
+/**
+ * Get the sentinel nodes from the solver settings.
+ *
+ * @param solver The 'solver' argument.
+ * @param args Structure with data for the solver.
+ * @param sentinel Vector of length Nn that is allocated by the
+ *        function, where a non-zero value indicates a sentinel
+ *        node. Must be freed by the caller.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_sentinel_setting(
+    SEXP solver,
+    const SimInf_solver_args *args,
+    int **sentinel)
+{
+    SEXP setting;
+    int i;
+
+    setting = Rf_getAttrib(solver, Rf_install("sentinel"));
+    if (!Rf_isInteger(setting))
+        return SIMINF_ERR_INVALID_SENTINEL;
+
+    *sentinel = calloc(args->Nn, sizeof(int));
+    if (!*sentinel)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    for (i = 0; i < LENGTH(setting); i++) {
+        const int node = INTEGER(setting)[i];
+
+        if (node == NA_INTEGER || node < 1 || node > args->Nn)
+            return SIMINF_ERR_INVALID_SENTINEL;
+        (*sentinel)[node - 1] = 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Create the trace buffers from the solver settings.
+ *
+ * The setting is the number of records in the ring buffer of each
+ * thread, where 0 means that the buffer can hold every phase of all
+ * time steps in the simulation.
+ *
+ * @param solver The 'solver' argument.
+ * @param args Structure with data for the solver.
+ * @param trace Vector of length Nthread with the trace buffers that
+ *        is allocated by the function. Must be freed by the caller
+ *        with SimInf_trace_free.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_trace_setting(
+    SEXP solver,
+    const SimInf_solver_args *args,
+    SimInf_trace **trace)
+{
+    SEXP setting;
+    size_t capacity;
+    int i;
+
+    setting = Rf_getAttrib(solver, Rf_install("trace"));
+    if (!Rf_isInteger(setting) || Rf_length(setting) != 1 ||
+        INTEGER(setting)[0] == NA_INTEGER || INTEGER(setting)[0] < 0)
+        return SIMINF_ERR_INVALID_TRACE;
+
+    capacity = INTEGER(setting)[0];
+    if (capacity == 0) {
+        /* Every thread records the transitions, the E1 events, the
+         * post time step function, two waits, and the E2 events on
+         * the master thread in each time step. */
+        const double steps =
+            ceil(args->tspan[args->tlen - 1] - args->tspan[0]) + 1.0;
+        capacity = (size_t)steps * (SIMINF_TRACE_N_PHASES + 1);
+    }
+
+    *trace = calloc(args->Nthread, sizeof(SimInf_trace));
+    if (!*trace)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    for (i = 0; i < args->Nthread; i++) {
+        (*trace)[i].capacity = capacity;
+        (*trace)[i].records = malloc(capacity * sizeof(SimInf_trace_record));
+        if (!(*trace)[i].records)
+            return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    }
+
+    return 0;
+}
+
+/**
+ * Free the trace buffers.
+ *
+ * @param trace Vector of length Nthread with the trace buffers.
+ * @param Nthread The number of threads.
+ */
+static void SimInf_trace_free(SimInf_trace *trace, int Nthread)
+{
+    if (trace) {
+        int i;
+
+        for (i = 0; i < Nthread; i++)
+            free(trace[i].records);
+        free(trace);
+    }
+}
+
+/**
+ * Create a list with the traced phases from all threads.
+ *
+ * @param args Structure with data for the solver.
+ * @return a list with the vectors 'thread' (one-based), 'phase'
+ *         (one-based), 'time', 'begin' and 'end'. The records of
+ *         each thread are in the order they were written.
+ */
+static SEXP SimInf_trace_list(const SimInf_solver_args *args)
+{
+    SEXP result, names;
+    double *time, *begin, *end;
+    int *thread, *phase;
+    size_t i, j, n = 0;
+    int k;
+
+    for (k = 0; k < args->Nthread; k++) {
+        const SimInf_trace *t = &args->trace[k];
+        n += t->n < t->capacity ? t->n : t->capacity;
+    }
+
+    PROTECT(result = Rf_allocVector(VECSXP, 5));
+    SET_VECTOR_ELT(result, 0, Rf_allocVector(INTSXP, n));
+    SET_VECTOR_ELT(result, 1, Rf_allocVector(INTSXP, n));
+    SET_VECTOR_ELT(result, 2, Rf_allocVector(REALSXP, n));
+    SET_VECTOR_ELT(result, 3, Rf_allocVector(REALSXP, n));
+    SET_VECTOR_ELT(result, 4, Rf_allocVector(REALSXP, n));
+    PROTECT(names = Rf_allocVector(STRSXP, 5));
+    SET_STRING_ELT(names, 0, Rf_mkChar("thread"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("phase"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("time"));
+    SET_STRING_ELT(names, 3, Rf_mkChar("begin"));
+    SET_STRING_ELT(names, 4, Rf_mkChar("end"));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+
+    thread = INTEGER(VECTOR_ELT(result, 0));
+    phase = INTEGER(VECTOR_ELT(result, 1));
+    time = REAL(VECTOR_ELT(result, 2));
+    begin = REAL(VECTOR_ELT(result, 3));
+    end = REAL(VECTOR_ELT(result, 4));
+    for (k = 0, i = 0; k < args->Nthread; k++) {
+        const SimInf_trace *t = &args->trace[k];
+
+        /* Unroll the ring buffer, starting with the oldest record. */
+        j = t->n < t->capacity ? 0 : t->n - t->capacity;
+        for (; j < t->n; j++, i++) {
+            const SimInf_trace_record *r = &t->records[j % t->capacity];
+
+            thread[i] = k + 1;
+            phase[i] = r->phase + 1;
+            time[i] = r->time;
+            begin[i] = r->begin;
+            end[i] = r->end;
+        }
+    }
+
+    UNPROTECT(2);
+
+    return result;
+}
+
+/**
+ * Create a list with the cost counters of each node.
+ *
+ * @param args Structure with data for the solver.
+ * @return a list with the vectors 'transitions', 'rate_evaluations',
+ *         'events', 'individuals' and 'cycles', where 'cycles' is
+ *         NA if the processor cycles are not counted.
+ */
+static SEXP SimInf_node_profile_list(const SimInf_solver_args *args)
+{
+    SEXP result, names;
+    double *x[5];
+    int i, j;
+
+    PROTECT(result = Rf_allocVector(VECSXP, 5));
+    PROTECT(names = Rf_allocVector(STRSXP, 5));
+    SET_STRING_ELT(names, 0, Rf_mkChar("transitions"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("rate_evaluations"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("events"));
+    SET_STRING_ELT(names, 3, Rf_mkChar("individuals"));
+    SET_STRING_ELT(names, 4, Rf_mkChar("cycles"));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+    for (j = 0; j < 5; j++) {
+        SET_VECTOR_ELT(result, j, Rf_allocVector(REALSXP, args->Nn));
+        x[j] = REAL(VECTOR_ELT(result, j));
+    }
+
+    for (i = 0; i < args->Nn; i++) {
+        x[0][i] = args->profile[i].transitions;
+        x[1][i] = args->profile[i].rate_evaluations;
+        x[2][i] = args->profile[i].events;
+        x[3][i] = args->profile[i].individuals;
+        x[4][i] = SIMINF_HAVE_CYCLES ? args->profile[i].cycles : NA_REAL;
+    }
+
+    UNPROTECT(2);
+
+    return result;
+}
+
+/**
+ * Get the data for the particle filter from the solver settings.
+ *
+ * The setting is a list with the items: the number of particles, the
+ * zero-based index in tspan of each observation, the zero-based node
+ * within the particle of each observation (or -1 for all nodes), the
+ * observed values, the observation distribution, the parameter of
+ * the distribution, and the zero-based compartments to observe.
+ *
+ * @param solver The 'solver' argument.
+ * @param args Structure with data for the solver.
+ * @param pfilter Structure to store the particle filter data in.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_pfilter_setting(
+    SEXP solver,
+    const SimInf_solver_args *args,
+    SimInf_pfilter *pfilter)
+{
+    SEXP setting;
+    int i, Nobs;
+
+    setting = Rf_getAttrib(solver, Rf_install("pfilter"));
+    if (!Rf_isNewList(setting) || Rf_length(setting) != 7)
+        return SIMINF_ERR_INVALID_PFILTER;
+
+    /* Check the type and length of the items before accessing them,
+     * so that an invalid setting is reported without an R error. */
+    for (i = 0; i < 7; i++) {
+        if (i == 5) {
+            if (!Rf_isReal(VECTOR_ELT(setting, i)))
+                return SIMINF_ERR_INVALID_PFILTER;
+        } else if (!Rf_isInteger(VECTOR_ELT(setting, i))) {
+            return SIMINF_ERR_INVALID_PFILTER;
+        }
+    }
+    Nobs = LENGTH(VECTOR_ELT(setting, 1));
+    if (LENGTH(VECTOR_ELT(setting, 0)) != 1 ||
+        LENGTH(VECTOR_ELT(setting, 2)) != Nobs ||
+        LENGTH(VECTOR_ELT(setting, 3)) != Nobs ||
+        LENGTH(VECTOR_ELT(setting, 4)) != 1 ||
+        LENGTH(VECTOR_ELT(setting, 5)) != 1)
+        return SIMINF_ERR_INVALID_PFILTER;
+
+    pfilter->Npart = INTEGER(VECTOR_ELT(setting, 0))[0];
+    pfilter->Nobs = Nobs;
+    pfilter->obs_time = INTEGER(VECTOR_ELT(setting, 1));
+    pfilter->obs_node = INTEGER(VECTOR_ELT(setting, 2));
+    pfilter->obs_value = INTEGER(VECTOR_ELT(setting, 3));
+    pfilter->dist = INTEGER(VECTOR_ELT(setting, 4))[0];
+    pfilter->p = REAL(VECTOR_ELT(setting, 5))[0];
+    pfilter->compartments = INTEGER(VECTOR_ELT(setting, 6));
+    pfilter->Ncompartments = LENGTH(VECTOR_ELT(setting, 6));
+
+    if (pfilter->Npart < 1 || args->Nn % pfilter->Npart)
+        return SIMINF_ERR_INVALID_PFILTER;
+    pfilter->Nn = args->Nn / pfilter->Npart;
+
+    if ((pfilter->dist != SIMINF_PFILTER_POISSON &&
+         pfilter->dist != SIMINF_PFILTER_BINOMIAL) ||
+        !R_FINITE(pfilter->p))
+        return SIMINF_ERR_INVALID_PFILTER;
+
+    for (i = 0; i < pfilter->Nobs; i++) {
+        if (pfilter->obs_time[i] < 0 || pfilter->obs_time[i] >= args->tlen ||
+            (i > 0 && pfilter->obs_time[i] < pfilter->obs_time[i - 1]) ||
+            pfilter->obs_node[i] < -1 || pfilter->obs_node[i] >= pfilter->Nn ||
+            pfilter->obs_value[i] < 0)
+            return SIMINF_ERR_INVALID_PFILTER;
+    }
+
+    for (i = 0; i < pfilter->Ncompartments; i++) {
+        if (pfilter->compartments[i] < 0 ||
+            pfilter->compartments[i] >= args->Nc)
+            return SIMINF_ERR_INVALID_PFILTER;
+    }
+
+    return 0;
+}
+
+/**
+ * Get the data for the group-level state from the solver settings.
+ *
+ * The setting is an integer vector with the (one-based) group of
+ * each node. The group states are the rows in 'ldata' with names
+ * 'group_<state>', where <state> is a compartment or a continuous
+ * state variable in 'v0'.
+ *
+ * @param solver The 'solver' argument.
+ * @param result The model to run.
+ * @param args Structure with data for the solver.
+ * @param groups Structure to store the group data in.
+ * @param buf Buffer with the group data that is allocated by the
+ *        function, and must be freed by the caller.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_groups_setting(
+    SEXP solver,
+    SEXP result,
+    const SimInf_solver_args *args,
+    SimInf_groups *groups,
+    int **buf)
+{
+    SEXP setting, ldata_names, u_names, v_names;
+    int i, j, *jc, *ir, *row, *state;
+
+    setting = Rf_getAttrib(solver, Rf_install("groups"));
+    if (!Rf_isInteger(setting) || LENGTH(setting) != args->Nn)
+        return SIMINF_ERR_INVALID_GROUPS;
+
+    for (i = 0; i < args->Nn; i++) {
+        if (INTEGER(setting)[i] == NA_INTEGER || INTEGER(setting)[i] < 1)
+            return SIMINF_ERR_INVALID_GROUPS;
+        if (INTEGER(setting)[i] > groups->Ng)
+            groups->Ng = INTEGER(setting)[i];
+    }
+
+    ldata_names = Rf_GetRowNames(
+        Rf_getAttrib(GET_SLOT(result, Rf_install("ldata")), R_DimNamesSymbol));
+    u_names = VECTOR_ELT(
+        GET_SLOT(GET_SLOT(result, Rf_install("S")), Rf_install("Dimnames")), 0);
+    v_names = Rf_GetRowNames(
+        Rf_getAttrib(GET_SLOT(result, Rf_install("v0")), R_DimNamesSymbol));
+
+    /* Count the rows with group states in 'ldata'. */
+    for (i = 0; !Rf_isNull(ldata_names) && i < LENGTH(ldata_names); i++) {
+        if (strncmp(CHAR(STRING_ELT(ldata_names, i)), "group_", 6) == 0)
+            groups->Nrow++;
+    }
+    if (groups->Nrow == 0)
+        return SIMINF_ERR_INVALID_GROUPS;
+
+    *buf = malloc((groups->Ng + 1 + args->Nn + 2 * groups->Nrow) * sizeof(int));
+    if (!*buf)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    jc = *buf;
+    ir = &jc[groups->Ng + 1];
+    row = &ir[args->Nn];
+    state = &row[groups->Nrow];
+
+    /* Match the name of each group state with the compartments and
+     * the continuous state variables. */
+    for (i = 0, j = 0; i < LENGTH(ldata_names); i++) {
+        const char *name = CHAR(STRING_ELT(ldata_names, i));
+        int k;
+
+        if (strncmp(name, "group_", 6) != 0)
+            continue;
+
+        row[j] = i;
+        state[j] = -1;
+        for (k = 0; !Rf_isNull(u_names) && k < LENGTH(u_names); k++) {
+            if (strcmp(name + 6, CHAR(STRING_ELT(u_names, k))) == 0)
+                state[j] = k;
+        }
+        for (k = 0; !Rf_isNull(v_names) && k < LENGTH(v_names); k++) {
+            if (strcmp(name + 6, CHAR(STRING_ELT(v_names, k))) == 0)
+                state[j] = args->Nc + k;
+        }
+        if (state[j] < 0)
+            return SIMINF_ERR_INVALID_GROUPS;
+        j++;
+    }
+
+    /* Sort the nodes by group with a counting sort. */
+    memset(jc, 0, (groups->Ng + 1) * sizeof(int));
+    for (i = 0; i < args->Nn; i++)
+        jc[INTEGER(setting)[i]]++;
+    for (i = 0; i < groups->Ng; i++)
+        jc[i + 1] += jc[i];
+    for (i = 0; i < args->Nn; i++)
+        ir[jc[INTEGER(setting)[i] - 1]++] = i;
+    for (i = groups->Ng; i > 0; i--)
+        jc[i] = jc[i - 1];
+    jc[0] = 0;
+
+    groups->jc = jc;
+    groups->ir = ir;
+    groups->row = row;
+    groups->state = state;
+    groups->ldata = REAL(GET_SLOT(result, Rf_install("ldata")));
+
+    return 0;
+}
+
 /**
  * Initiate and run the simulation
  *
@@ -103,7 +595,13 @@ SEXP attribute_hidden SimInf_run(
     SEXP ext_events, E, G, N, S, prS;
     SEXP tspan;
     SEXP U, V, U_sparse, V_sparse;
+    SEXP ess = R_NilValue;
     SimInf_solver_args args = {0};
+    SimInf_pfilter pfilter = {0};
+    SimInf_groups groups = {0};
+    int *groups_buf = NULL, *sentinel = NULL;
+    SimInf_trace *trace = NULL;
+    SimInf_node_profile *profile = NULL;
 
     /* If the model ldata is a 0x0 matrix, i.e. Nld == 0, then use
      * ldata_tmp in the transition rate functions. This is to make
@@ -172,6 +670,10 @@ SEXP attribute_hidden SimInf_run(
     args.proportion = REAL(GET_SLOT(ext_events, Rf_install("proportion")));
     args.select = INTEGER(GET_SLOT(ext_events, Rf_install("select")));
     args.shift = INTEGER(GET_SLOT(ext_events, Rf_install("shift")));
+    if (LENGTH(GET_SLOT(ext_events, Rf_install("period")))) {
+        args.period = INTEGER(GET_SLOT(ext_events, Rf_install("period")));
+        args.end = INTEGER(GET_SLOT(ext_events, Rf_install("end")));
+    }
 
     /* Select matrix. */
     PROTECT(E = GET_SLOT(ext_events, Rf_install("E")));
@@ -194,6 +696,58 @@ SEXP attribute_hidden SimInf_run(
     args.Nld = INTEGER(GET_SLOT(GET_SLOT(result, Rf_install("ldata")), R_DimSymbol))[0];
     args.tlen = LENGTH(GET_SLOT(result, Rf_install("tspan")));
 
+    /* Initial state. */
+    args.u0 = INTEGER(GET_SLOT(result, Rf_install("u0")));
+    args.v0 = REAL(GET_SLOT(result, Rf_install("v0")));
+
+    /* Local data */
+    if (args.Nld > 0)
+        args.ldata = REAL(GET_SLOT(result, Rf_install("ldata")));
+    else
+        args.ldata = ldata_tmp;
+
+    /* Global data */
+    args.gdata = REAL(GET_SLOT(result, Rf_install("gdata")));
+
+    /* Function pointers */
+    args.tr_fun = tr_fun;
+    args.pts_fun = pts_fun;
+
+    /* Probe the transition rate functions to determine the
+     * dependency graph instead of running the model. The probe
+     * does not use the output arrays, so return before they are
+     * allocated. */
+    if (!Rf_isNull(solver) &&
+        !Rf_isNull(Rf_getAttrib(solver, Rf_install("probe")))) {
+        SEXP probe = Rf_getAttrib(solver, Rf_install("probe"));
+        SEXP pr, names;
+
+        if (!Rf_isInteger(probe) || Rf_length(probe) != 1 ||
+            INTEGER(probe)[0] < 1) {
+            error = SIMINF_ERR_INVALID_PROBE;
+            goto cleanup;
+        }
+
+        PROTECT(pr = Rf_allocVector(VECSXP, 2));
+        nprotect++;
+        SET_VECTOR_ELT(pr, 0, Rf_allocMatrix(INTSXP, args.Nt, args.Nt));
+        SET_VECTOR_ELT(pr, 1, Rf_allocVector(REALSXP, args.Nt));
+        PROTECT(names = Rf_allocVector(STRSXP, 2));
+        nprotect++;
+        SET_STRING_ELT(names, 0, Rf_mkChar("G"));
+        SET_STRING_ELT(names, 1, Rf_mkChar("rate"));
+        Rf_setAttrib(pr, R_NamesSymbol, names);
+        memset(INTEGER(VECTOR_ELT(pr, 0)), 0,
+               args.Nt * args.Nt * sizeof(int));
+
+        error = SimInf_probe_dependency_graph(
+            &args, INTEGER(probe)[0], INTEGER(VECTOR_ELT(pr, 0)),
+            REAL(VECTOR_ELT(pr, 1)));
+        if (!error)
+            Rf_setAttrib(result, Rf_install("probe"), pr);
+        goto cleanup;
+    }
+
     /* Output array (to hold a single trajectory) */
     PROTECT(U_sparse = GET_SLOT(result, Rf_install("U_sparse")));
     nprotect++;
@@ -222,27 +776,71 @@ SEXP attribute_hidden SimInf_run(
         args.V = REAL(GET_SLOT(result, Rf_install("V")));
     }
 
-    /* Initial state. */
-    args.u0 = INTEGER(GET_SLOT(result, Rf_install("u0")));
-    args.v0 = REAL(GET_SLOT(result, Rf_install("v0")));
+    /* Optional solver settings. */
+    args.log_outcomes = SimInf_solver_setting_logical(solver, "event_outcomes");
+    args.compartment_major = SimInf_solver_setting_logical(
+        solver, "compartment_major");
+    if (SimInf_solver_setting_logical(solver, "profile")) {
+        profile = calloc(args.Nn, sizeof(SimInf_node_profile));
+        if (!profile) {
+            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+            goto cleanup;                           /* #nocov */
+        }
+        args.profile = profile;
+    }
+    if (!Rf_isNull(solver) &&
+        !Rf_isNull(Rf_getAttrib(solver, Rf_install("pfilter")))) {
+        int i;
 
-    /* Local data */
-    if (args.Nld > 0)
-        args.ldata = REAL(GET_SLOT(result, Rf_install("ldata")));
-    else
-        args.ldata = ldata_tmp;
+        /* The particle filter resamples the state of the nodes
+         * between time steps, which is only supported by the 'ssm'
+         * solver. */
+        if (strcmp(CHAR(STRING_ELT(solver, 0)), "ssm") != 0) {
+            error = SIMINF_ERR_PFILTER_SOLVER;
+            goto cleanup;
+        }
 
-    /* Global data */
-    args.gdata = REAL(GET_SLOT(result, Rf_install("gdata")));
+        error = SimInf_pfilter_setting(solver, &args, &pfilter);
+        if (error)
+            goto cleanup;
 
-    /* Function pointers */
-    args.tr_fun = tr_fun;
-    args.pts_fun = pts_fun;
+        PROTECT(ess = Rf_allocVector(REALSXP, args.tlen));
+        nprotect++;
+        for (i = 0; i < args.tlen; i++)
+            REAL(ess)[i] = NA_REAL;
+        pfilter.ess = REAL(ess);
+        args.pfilter = &pfilter;
+    }
+
+    if (!Rf_isNull(solver) &&
+        !Rf_isNull(Rf_getAttrib(solver, Rf_install("groups")))) {
+        error = SimInf_groups_setting(solver, result, &args, &groups,
+                                      &groups_buf);
+        if (error)
+            goto cleanup;
+        args.groups = &groups;
+    }
+
+    if (!Rf_isNull(solver) &&
+        !Rf_isNull(Rf_getAttrib(solver, Rf_install("sentinel")))) {
+        error = SimInf_sentinel_setting(solver, &args, &sentinel);
+        if (error)
+            goto cleanup;
+        args.sentinel = sentinel;
+    }
 
     /* Specify the number of threads to use. Make sure to not use more
      * threads than the number of nodes in the model. */
     args.Nthread = SimInf_set_num_threads(args.Nn);
 
+    if (!Rf_isNull(solver) &&
+        !Rf_isNull(Rf_getAttrib(solver, Rf_install("trace")))) {
+        error = SimInf_trace_setting(solver, &args, &trace);
+        if (error)
+            goto cleanup;
+        args.trace = trace;
+    }
+
     /* Run the simulation solver. */
     if (Rf_isNull(solver) || (strcmp(CHAR(STRING_ELT(solver, 0)), "ssm") == 0))
         error = SimInf_run_solver_ssm(&args);
@@ -251,7 +849,87 @@ SEXP attribute_hidden SimInf_run(
     else
         error = SIMINF_ERR_UNKNOWN_SOLVER;
 
+    /* Attach the log of event outcomes to the result, and make sure
+     * to not keep a log from a previous run of the model. */
+    if (!error) {
+        SEXP outcomes = R_NilValue;
+
+        if (args.log_outcomes) {
+            PROTECT(outcomes = SimInf_event_outcomes(&args));
+            nprotect++;
+        }
+
+        Rf_setAttrib(result, Rf_install("event_outcomes"), outcomes);
+
+        /* Attach the transitions in the sentinel nodes. */
+        if (args.sentinel) {
+            SEXP transitions;
+
+            PROTECT(transitions = SimInf_transitions(&args));
+            nprotect++;
+            Rf_setAttrib(result, Rf_install("transitions"), transitions);
+        } else {
+            Rf_setAttrib(result, Rf_install("transitions"), R_NilValue);
+        }
+
+        /* Attach the traced phases of the solver. */
+        if (args.trace) {
+            SEXP tr;
+
+            PROTECT(tr = SimInf_trace_list(&args));
+            nprotect++;
+            Rf_setAttrib(result, Rf_install("trace"), tr);
+        } else {
+            Rf_setAttrib(result, Rf_install("trace"), R_NilValue);
+        }
+
+        /* Attach the cost counters of each node. */
+        if (args.profile) {
+            SEXP pr;
+
+            PROTECT(pr = SimInf_node_profile_list(&args));
+            nprotect++;
+            Rf_setAttrib(result, Rf_install("profile"), pr);
+        } else {
+            Rf_setAttrib(result, Rf_install("profile"), R_NilValue);
+        }
+
+        /* Mark a dense U and V that was written compartment-major. */
+        if (args.compartment_major) {
+            Rf_setAttrib(result, Rf_install("layout"),
+                         Rf_mkString("compartment"));
+        } else {
+            Rf_setAttrib(result, Rf_install("layout"), R_NilValue);
+        }
+
+        /* Attach the log-likelihood estimate and the effective
+         * sample size from the particle filter. */
+        if (args.pfilter) {
+            SEXP pf, names;
+
+            PROTECT(pf = Rf_allocVector(VECSXP, 2));
+            nprotect++;
+            SET_VECTOR_ELT(pf, 0, Rf_ScalarReal(pfilter.loglik));
+            SET_VECTOR_ELT(pf, 1, ess);
+            PROTECT(names = Rf_allocVector(STRSXP, 2));
+            nprotect++;
+            SET_STRING_ELT(names, 0, Rf_mkChar("loglik"));
+            SET_STRING_ELT(names, 1, Rf_mkChar("ess"));
+            Rf_setAttrib(pf, R_NamesSymbol, names);
+            Rf_setAttrib(result, Rf_install("pfilter"), pf);
+        } else {
+            Rf_setAttrib(result, Rf_install("pfilter"), R_NilValue);
+        }
+    }
+    free(args.outcomes);
+    free(args.transitions);
+
 cleanup:
+    free(groups_buf);
+    free(sentinel);
+    SimInf_trace_free(trace, args.Nthread);
+    free(profile);
+
     if (error)
         SimInf_raise_error(error);
 
@@ -33,12 +33,20 @@ SEXP SISe_run(SEXP, SEXP);
 SEXP SISe3_run(SEXP, SEXP);
 SEXP SISe3_sp_run(SEXP, SEXP);
 SEXP SISe_sp_run(SEXP, SEXP);
-SEXP SimInf_abc_proposals(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP SimInf_abc_knn(SEXP, SEXP, SEXP, SEXP);
+SEXP SimInf_abc_olcm(SEXP, SEXP, SEXP);
+SEXP SimInf_abc_proposals(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 SEXP SimInf_abc_weights(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP SimInf_arrow_read(SEXP, SEXP);
+SEXP SimInf_compare(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 SEXP SimInf_have_openmp();
 SEXP SimInf_init_threads(SEXP);
 SEXP SimInf_ldata_sp(SEXP, SEXP, SEXP);
-SEXP SimInf_trajectory(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP SimInf_reachable(SEXP, SEXP, SEXP);
+SEXP SimInf_trajectory(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP SimInf_trajectory_arrow(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP SimInf_valid_events(SEXP);
+SEXP SimInf_valid_state(SEXP, SEXP);
 
 #define CALLDEF(name, n) {#name, (DL_FUNC) &name, n}
 
@@ -50,12 +58,20 @@ static const R_CallMethodDef callMethods[] =
     CALLDEF(SISe3_run, 2),
     CALLDEF(SISe3_sp_run, 2),
     CALLDEF(SISe_sp_run, 2),
-    CALLDEF(SimInf_abc_proposals, 8),
+    CALLDEF(SimInf_abc_knn, 4),
+    CALLDEF(SimInf_abc_olcm, 3),
+    CALLDEF(SimInf_abc_proposals, 9),
     CALLDEF(SimInf_abc_weights, 7),
+    CALLDEF(SimInf_arrow_read, 2),
+    CALLDEF(SimInf_compare, 8),
     CALLDEF(SimInf_have_openmp, 0),
     CALLDEF(SimInf_init_threads, 1),
     CALLDEF(SimInf_ldata_sp, 3),
-    CALLDEF(SimInf_trajectory, 10),
+    CALLDEF(SimInf_reachable, 3),
+    CALLDEF(SimInf_trajectory, 11),
+    CALLDEF(SimInf_trajectory_arrow, 11),
+    CALLDEF(SimInf_valid_events, 1),
+    CALLDEF(SimInf_valid_state, 2),
     {NULL, NULL, 0}
 };
 
@@ -32,7 +32,8 @@ SEXP attribute_hidden SimInf_abc_proposals(
     SEXP n,
     SEXP x,
     SEXP w,
-    SEXP sigma)
+    SEXP sigma,
+    SEXP qmc)
 {
     SIMINF_UNUSED(parameter);
     SIMINF_UNUSED(distribution);
@@ -42,6 +43,7 @@ SEXP attribute_hidden SimInf_abc_proposals(
     SIMINF_UNUSED(x);
     SIMINF_UNUSED(w);
     SIMINF_UNUSED(sigma);
+    SIMINF_UNUSED(qmc);
 
     Rf_error("The installed version of the GNU Scientific Library (GSL) that "
              "is required to build SimInf with support for ABC is to old. "
@@ -76,17 +78,57 @@ SEXP attribute_hidden SimInf_abc_weights(
     return R_NilValue;
 }
 
+SEXP attribute_hidden SimInf_abc_olcm(
+    SEXP x,
+    SEXP w,
+    SEXP subset)
+{
+    SIMINF_UNUSED(x);
+    SIMINF_UNUSED(w);
+    SIMINF_UNUSED(subset);
+
+    Rf_error("The installed version of the GNU Scientific Library (GSL) that "
+             "is required to build SimInf with support for ABC is to old. "
+             "Please install GSL version >= 2.2 and reinstall SimInf if you "
+             "need that functionality.");
+
+    return R_NilValue;
+}
+
+SEXP attribute_hidden SimInf_abc_knn(
+    SEXP x,
+    SEXP accept,
+    SEXP xx,
+    SEXP k)
+{
+    SIMINF_UNUSED(x);
+    SIMINF_UNUSED(accept);
+    SIMINF_UNUSED(xx);
+    SIMINF_UNUSED(k);
+
+    Rf_error("The installed version of the GNU Scientific Library (GSL) that "
+             "is required to build SimInf with support for ABC is to old. "
+             "Please install GSL version >= 2.2 and reinstall SimInf if you "
+             "need that functionality.");
+
+    return R_NilValue;
+}
+
 #else
 
+# include <string.h>
 # include <R.h>
 # include <Rdefines.h>
 # include <Rmath.h>
 # include <R_ext/Visibility.h>
+# include <gsl/gsl_errno.h>
 # include <gsl/gsl_matrix.h>
 # include <gsl/gsl_linalg.h>
+# include <gsl/gsl_qrng.h>
 # include <gsl/gsl_randist.h>
 # include <gsl/gsl_rng.h>
 # include "SimInf_arg.h"
+# include "SimInf_openmp.h"
 
 static void SimInf_abc_error(int error)
 {
@@ -100,12 +142,223 @@ static void SimInf_abc_error(int error)
     case 3:
         Rf_error("Invalid weight detected (non-finite or < 0.0).");
         break;
+    case 4:
+        Rf_error("The variance-covariance matrix of the proposal kernel "
+                 "is not positive definite.");
+        break;
+    case 5:
+        Rf_error("Invalid dimension of the variance-covariance matrix.");
+        break;
+    case 6:
+        Rf_error("Too many parameters for the quasi-random sequence.");
+        break;
+    case 7:
+        Rf_error("Unknown quasi-random sequence.");
+        break;
+    case 8:
+        Rf_error("The random shift of the quasi-random sequence must "
+                 "have one value for each dimension.");
+        break;
     default:                                        /* #nocov */
         Rf_error("Unknown error code: %i.", error); /* #nocov */
         break;
     }
 }
 
+/**
+ * Free the Cholesky decompositions of the proposal kernels.
+ *
+ * @param L the array of matrices to free.
+ * @param n the number of matrices in L.
+ */
+static void SimInf_abc_cholesky_free(gsl_matrix **L, int n)
+{
+    if (L) {
+        for (int i = 0; i < n; i++)
+            gsl_matrix_free(L[i]);
+        free(L);
+    }
+}
+
+/**
+ * Compute the Cholesky decomposition of the variance-covariance
+ * matrix of the proposal kernel.
+ *
+ * @param out the array with the Cholesky decomposition of each
+ *        variance-covariance matrix in sigma.
+ * @param nout the number of matrices in out.
+ * @param sigma either one variance-covariance matrix (k x k) that is
+ *        used for every particle, or an array (k x k x n) with one
+ *        variance-covariance matrix for each of the n particles in
+ *        the previous generation, for example, from the optimal
+ *        local covariance matrix (OLCM) kernel.
+ * @param k the number of parameters.
+ * @param n the number of particles in the previous generation.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_abc_cholesky(
+    gsl_matrix ***out,
+    int *nout,
+    SEXP sigma,
+    int k,
+    int n)
+{
+    int error = 0, len;
+    gsl_matrix **L = NULL;
+    gsl_error_handler_t *handler;
+
+    if (XLENGTH(sigma) == (R_xlen_t)k * k)
+        len = 1;
+    else if (XLENGTH(sigma) == (R_xlen_t)k * k * n)
+        len = n;
+    else
+        return 5;
+
+    L = calloc(len, sizeof(gsl_matrix*));
+    if (!L)
+        return 1; /* #nocov */
+
+    /* Report a matrix that is not positive definite as an error
+     * instead of calling the default GSL error handler, which
+     * aborts. */
+    handler = gsl_set_error_handler_off();
+    for (int i = 0; i < len && !error; i++) {
+        gsl_matrix_view v_sigma =
+            gsl_matrix_view_array(&REAL(sigma)[(R_xlen_t)i * k * k], k, k);
+
+        L[i] = gsl_matrix_alloc(k, k);
+        if (!L[i]) {
+            error = 1; /* #nocov */
+            break;     /* #nocov */
+        }
+
+        gsl_matrix_memcpy(L[i], &v_sigma.matrix);
+        if (gsl_linalg_cholesky_decomp1(L[i]))
+            error = 4;
+    }
+    gsl_set_error_handler(handler);
+
+    if (error) {
+        SimInf_abc_cholesky_free(L, len);
+        return error;
+    }
+
+    *out = L;
+    *nout = len;
+
+    return 0;
+}
+
+/**
+ * Randomized quasi-random sequence to sample the proposals.
+ */
+typedef struct SimInf_abc_qmc
+{
+    gsl_qrng *qrng;      /**< The quasi-random sequence. */
+    int sobol;           /**< 1 if Sobol, 0 if Halton. */
+    int d;               /**< The dimension of the sequence. */
+    int index;           /**< The index of the next point. */
+    const double *shift; /**< The random shift of each dimension. */
+    double *u;           /**< The current point in (0, 1)^d. */
+} SimInf_abc_qmc;
+
+/**
+ * Free the quasi-random sequence.
+ *
+ * @param qmc the quasi-random sequence to free.
+ */
+static void SimInf_abc_qmc_free(SimInf_abc_qmc *qmc)
+{
+    gsl_qrng_free(qmc->qrng);
+    free(qmc->u);
+}
+
+/**
+ * Setup the quasi-random sequence and skip to the first unused
+ * point, such that the points are continued over the calls within a
+ * generation.
+ *
+ * @param qmc the quasi-random sequence to setup.
+ * @param arg NULL to use pseudo-random numbers, or a list with the
+ *        name of the sequence ("sobol" or "halton"), the random shift
+ *        of each dimension in [0, 1), and the index of the first
+ *        unused point.
+ * @param d the dimension of the sequence.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_abc_qmc_init(SimInf_abc_qmc *qmc, SEXP arg, int d)
+{
+    const char *sequence;
+
+    memset(qmc, 0, sizeof(SimInf_abc_qmc));
+    if (Rf_isNull(arg))
+        return 0;
+
+    sequence = R_CHAR(STRING_ELT(VECTOR_ELT(arg, 0), 0));
+    if (strcmp(sequence, "sobol") == 0) {
+        /* The maximum dimension of the GSL Sobol sequence. */
+        if (d > 40)
+            return 6;
+        qmc->sobol = 1;
+    } else if (strcmp(sequence, "halton") == 0) {
+        /* The maximum dimension of the GSL Halton sequence. */
+        if (d > 1229)
+            return 6;
+    } else {
+        return 7;
+    }
+
+    if (XLENGTH(VECTOR_ELT(arg, 1)) != d)
+        return 8;
+
+    qmc->d = d;
+    qmc->shift = REAL(VECTOR_ELT(arg, 1));
+    qmc->index = INTEGER(VECTOR_ELT(arg, 2))[0];
+    qmc->u = malloc(d * sizeof(double));
+    qmc->qrng = gsl_qrng_alloc(qmc->sobol ? gsl_qrng_sobol :
+                               gsl_qrng_reversehalton, d);
+    if (!qmc->u || !qmc->qrng)
+        return 1; /* #nocov */
+
+    for (int i = 0; i < qmc->index; i++)
+        gsl_qrng_get(qmc->qrng, qmc->u);
+
+    return 0;
+}
+
+/**
+ * Generate the next point of the randomized quasi-random sequence.
+ * The Sobol points are randomized with a random digital shift, which
+ * preserves their net structure, and the Halton points with a random
+ * shift modulo 1. In both cases, each point is uniformly distributed
+ * in (0, 1)^d, such that the proposals have the same distribution as
+ * with pseudo-random numbers and the weights are unchanged.
+ *
+ * @param qmc the quasi-random sequence.
+ */
+static void SimInf_abc_qmc_next(SimInf_abc_qmc *qmc)
+{
+    const double scale = 4294967296.0; /* 2^32 */
+
+    gsl_qrng_get(qmc->qrng, qmc->u);
+    qmc->index++;
+
+    for (int d = 0; d < qmc->d; d++) {
+        if (qmc->sobol) {
+            unsigned int a = (unsigned int)(qmc->u[d] * scale);
+            unsigned int b = (unsigned int)(qmc->shift[d] * scale);
+
+            qmc->u[d] = ((double)(a ^ b) + 0.5) / scale;
+        } else {
+            qmc->u[d] += qmc->shift[d];
+            if (qmc->u[d] >= 1.0)
+                qmc->u[d] -= 1.0;
+            if (qmc->u[d] <= 0.0)
+                qmc->u[d] = 0.5 / scale;
+        }
+    }
+}
+
 /**
  * Utility function for implementing the Approximate Bayesian
  * Computation Sequential Monte Carlo (ABC-SMC) algorithm of Toni et
@@ -127,10 +380,24 @@ static void SimInf_abc_error(int error)
  *        generation of particles or NULL.
  * @param w a numeric vector with weigths for the previous generation
  *        of particles or NULL.
- * @param sigma variance-covariance matrix.
+ * @param sigma variance-covariance matrix (parameters x parameters),
+ *        or an array (parameters x parameters x particles) with one
+ *        variance-covariance matrix for each particle in x.
+ * @param qmc NULL to sample with pseudo-random numbers, or a list
+ *        with the name of the quasi-random sequence ("sobol" or
+ *        "halton"), the random shift of each dimension, and the index
+ *        of the first unused point in the sequence. The dimension of
+ *        the sequence is the number of parameters in the first
+ *        generation, where the points are transformed with the
+ *        quantile functions of the priors. In later generations, the
+ *        first dimension selects the particle to perturb, and the
+ *        remaining dimensions are transformed to the standard normal
+ *        deviates of the Gaussian perturbation.
  * @return a numeric matrix (parameters x particles) with
  *         proposals. The matrix also has an attribute 'ancestor' with
- *         an index that indicates which particle it was sampled from.
+ *         an index that indicates which particle it was sampled from,
+ *         and, if 'qmc' is non-NULL, an attribute 'qmc_index' with
+ *         the index of the first unused point in the sequence.
  */
 SEXP attribute_hidden SimInf_abc_proposals(
     SEXP parameter,
@@ -140,12 +407,13 @@ SEXP attribute_hidden SimInf_abc_proposals(
     SEXP n,
     SEXP x,
     SEXP w,
-    SEXP sigma)
+    SEXP sigma,
+    SEXP qmc)
 {
-    int error = 0, k, len = 0, N;
+    int error = 0, k, len = 0, N, n_L = 0;
     gsl_rng *rng = NULL;
-    gsl_matrix_view v_sigma;
-    gsl_matrix *SIGMA = NULL;
+    gsl_matrix **L = NULL;
+    SimInf_abc_qmc q = {NULL, 0, 0, 0, NULL, NULL};
     double *ptr_x = NULL, *ptr_w = NULL, *cdf = NULL;
     double *ptr_p1 = REAL(p1), *ptr_p2 = REAL(p2);
     SEXP xx, ancestor, dimnames;
@@ -187,10 +455,43 @@ SEXP attribute_hidden SimInf_abc_proposals(
     }
     gsl_rng_set(rng, runif(1, UINT_MAX));
 
+    /* Setup the quasi-random sequence. */
+    error = SimInf_abc_qmc_init(&q, qmc, Rf_isNull(x) ? k : k + 1);
+    if (error)
+        goto cleanup;
+
     if (Rf_isNull(x)) {
         /* First generation: sample from priors. */
         for (int i = 0; i < N; i++) {
             ptr_ancestor[i] = NA_INTEGER;
+
+            if (q.qrng) {
+                /* Transform the quasi-random point with the quantile
+                 * function of each prior. */
+                SimInf_abc_qmc_next(&q);
+                for (int d = 0; d < k; d++) {
+                    switch(R_CHAR(STRING_ELT(distribution, d))[0]) {
+                    case 'g':
+                        ptr_xx[i * k + d] =
+                            qgamma(q.u[d], ptr_p1[d], 1.0 / ptr_p2[d], 1, 0);
+                        break;
+                    case 'n':
+                        ptr_xx[i * k + d] =
+                            qnorm(q.u[d], ptr_p1[d], ptr_p2[d], 1, 0);
+                        break;
+                    case 'u':
+                        ptr_xx[i * k + d] =
+                            qunif(q.u[d], ptr_p1[d], ptr_p2[d], 1, 0);
+                        break;
+                    default:
+                        error = 2;
+                        goto cleanup;
+                    }
+                }
+
+                continue;
+            }
+
             for (int d = 0; d < k; d++) {
                 switch(R_CHAR(STRING_ELT(distribution, d))[0]) {
                 case 'g':
@@ -212,15 +513,11 @@ SEXP attribute_hidden SimInf_abc_proposals(
         goto cleanup;
     }
 
-    /* Setup variance-covariance matrix. */
-    v_sigma = gsl_matrix_view_array(REAL(sigma), k, k);
-    SIGMA = gsl_matrix_alloc(k, k);
-    if (!SIGMA) {
-        error = 1;    /* #nocov */
-        goto cleanup; /* #nocov */
-    }
-    gsl_matrix_memcpy(SIGMA, &v_sigma.matrix);
-    gsl_linalg_cholesky_decomp1(SIGMA);
+    /* Setup the Cholesky decomposition of the variance-covariance
+     * matrix of the proposal kernel. */
+    error = SimInf_abc_cholesky(&L, &n_L, sigma, k, len);
+    if (error)
+        goto cleanup;
 
     /* Setup weights */
     ptr_x = REAL(x);
@@ -250,7 +547,13 @@ SEXP attribute_hidden SimInf_abc_proposals(
              * binary search to determine the sampled particle based
              * on its weight: [0, cdf_0), [cdf_0, cdf_1), ... */
             int j = 0, j_low = 0, j_high = len - 1;
-            double r = unif_rand() * cdf[j_high]; /* r ~ U[0, cdf[j_high]) */
+            double r;
+
+            if (q.qrng)
+                SimInf_abc_qmc_next(&q);
+
+            /* r ~ U[0, cdf[j_high]) */
+            r = (q.qrng ? q.u[0] : unif_rand()) * cdf[j_high];
             while (j_low < j_high) {
                 j = (j_low + j_high) / 2;
                 if (cdf[j] <= r)
@@ -262,8 +565,25 @@ SEXP attribute_hidden SimInf_abc_proposals(
 
             /* Perturbate the particle. */
             X = gsl_vector_view_array(&ptr_x[j * k], k);
-            gsl_ran_multivariate_gaussian(rng, &X.vector, SIGMA,
-                                          &proposal.vector);
+            if (q.qrng) {
+                /* The proposal is x + Lz, where z are the standard
+                 * normal deviates of the quasi-random point and L is
+                 * the lower triangular Cholesky factor. */
+                const gsl_matrix *L_j = L[n_L > 1 ? j : 0];
+
+                for (int d = 0; d < k; d++)
+                    q.u[d + 1] = qnorm(q.u[d + 1], 0.0, 1.0, 1, 0);
+                for (int d = 0; d < k; d++) {
+                    double value = ptr_x[j * k + d];
+                    for (int e = 0; e <= d; e++)
+                        value += gsl_matrix_get(L_j, d, e) * q.u[e + 1];
+                    ptr_xx[i * k + d] = value;
+                }
+            } else {
+                gsl_ran_multivariate_gaussian(rng, &X.vector,
+                                              L[n_L > 1 ? j : 0],
+                                              &proposal.vector);
+            }
 
             /* Check that the proposal is valid. */
             accept = 1;
@@ -275,7 +595,7 @@ SEXP attribute_hidden SimInf_abc_proposals(
                     density = dgamma(ptr_xx[i * k + d], ptr_p1[d], 1.0 / ptr_p2[d], 0);
                     break;
                 case 'n':
-                    density = dnorm(ptr_xx[i * k + d], ptr_x[j * k + d], ptr_p2[d], 0);
+                    density = dnorm(ptr_xx[i * k + d], ptr_p1[d], ptr_p2[d], 0);
                     break;
                 case 'u':
                     density = dunif(ptr_xx[i * k + d], ptr_p1[d], ptr_p2[d], 0);
@@ -292,8 +612,13 @@ SEXP attribute_hidden SimInf_abc_proposals(
     }
 
 cleanup:
+    if (q.qrng) {
+        Rf_setAttrib(xx, Rf_install("qmc_index"),
+                     Rf_ScalarInteger(q.index));
+    }
+    SimInf_abc_qmc_free(&q);
     free(cdf);
-    gsl_matrix_free(SIGMA);
+    SimInf_abc_cholesky_free(L, n_L);
     gsl_rng_free(rng);
     PutRNGstate();
 
@@ -309,6 +634,7 @@ cleanup:
  * Utility function for implementing the Approximate Bayesian
  * Computation Sequential Monte Carlo (ABC-SMC) algorithm of Toni et
  * al. (2009). Calculate weights for current generation of particles.
+ * The weights are computed in parallel over the particles.
  *
  * @param distribution character vector with the name of the
  *        distribution for each prior. Each entry must contain one of
@@ -323,7 +649,9 @@ cleanup:
  *        current generation of particles or NULL.
  * @param w a numeric vector with weights for the previous generation
  *        of particles.
- * @param sigma variance-covariance matrix.
+ * @param sigma variance-covariance matrix (parameters x parameters),
+ *        or an array (parameters x parameters x particles) with one
+ *        variance-covariance matrix for each particle in x.
  * @return a numeric vector with weights for the current generation of
  *         particles.
  */
@@ -336,14 +664,13 @@ SEXP attribute_hidden SimInf_abc_weights(
     SEXP w,
     SEXP sigma)
 {
-    int error = 0;
-    int k, n = Rf_ncols(xx);
-    gsl_matrix_view v_sigma;
-    gsl_matrix *SIGMA = NULL;
-    gsl_vector *work = NULL;
+    int error = 0, n_L = 0;
+    int k, n = Rf_ncols(xx), len;
+    gsl_matrix **L = NULL;
+    char *dist = NULL;
     SEXP ww;
     double *ptr_p1, *ptr_p2, *ptr_x, *ptr_xx, *ptr_w, *ptr_ww;
-    double sum, max_ww = 0.0;
+    double sum, max_ww = -INFINITY;
 
     PROTECT(ww = Rf_allocVector(REALSXP, n));
     ptr_ww = REAL(ww);
@@ -353,66 +680,108 @@ SEXP attribute_hidden SimInf_abc_weights(
         goto cleanup;
     }
 
-    k = INTEGER(GET_SLOT(sigma, R_DimSymbol))[0];
+    k = Rf_nrows(xx);
+    len = Rf_ncols(x);
     ptr_p1 = REAL(p1);
     ptr_p2 = REAL(p2);
     ptr_x = REAL(x);
     ptr_xx = REAL(xx);
     ptr_w = REAL(w);
-    work = gsl_vector_alloc(k);
 
-    /* Setup variance-covariance matrix. */
-    v_sigma = gsl_matrix_view_array(REAL(sigma), k, k);
-    SIGMA = gsl_matrix_alloc(k, k);
-    if (!SIGMA) {
+    for (int j = 0; j < len; j++) {
+        if (!R_FINITE(ptr_w[j]) || ptr_w[j] < 0.0) {
+            error = 3;
+            goto cleanup;
+        }
+    }
+
+    /* Copy the first character of each distribution to be able to
+     * compute the prior densities without accessing R objects in the
+     * parallel region. */
+    dist = malloc(k * sizeof(char));
+    if (!dist) {
         error = 1;    /* #nocov */
         goto cleanup; /* #nocov */
     }
-    gsl_matrix_memcpy(SIGMA, &v_sigma.matrix);
-    gsl_linalg_cholesky_decomp1(SIGMA);
+    for (int d = 0; d < k; d++) {
+        dist[d] = R_CHAR(STRING_ELT(distribution, d))[0];
+        if (dist[d] != 'g' && dist[d] != 'n' && dist[d] != 'u') {
+            error = 2;
+            goto cleanup;
+        }
+    }
 
-    for (int i = 0; i < n; i++) {
-        gsl_vector_view v_xx = gsl_vector_view_array(&ptr_xx[i * k], k);
-
-        ptr_ww[i] = 0.0;
-        for (int d = 0; d < k; d++) {
-            switch(R_CHAR(STRING_ELT(distribution, d))[0]) {
-            case 'g':
-                ptr_ww[i] +=
-                    dgamma(ptr_xx[i * k + d], ptr_p1[d], 1.0 / ptr_p2[d], 1);
-                break;
-            case 'n':
-                ptr_ww[i] +=
-                    dnorm(ptr_xx[i * k + d], ptr_x[i * k + d], ptr_p2[d], 1);
-                break;
-            case 'u':
-                ptr_ww[i] +=
-                    dunif(ptr_xx[i * k + d], ptr_p1[d], ptr_p2[d], 1);
-                break;
-            default:
-                error = 2;
-                goto cleanup;
+    /* Setup the Cholesky decomposition of the variance-covariance
+     * matrix of the proposal kernel. */
+    error = SimInf_abc_cholesky(&L, &n_L, sigma, k, len);
+    if (error)
+        goto cleanup;
+
+    /* The log of the weight of particle i is the log of its prior
+     * density minus the log of the density of the mixture of
+     * proposal kernels around the particles in the previous
+     * generation. */
+    #ifdef _OPENMP
+    #  pragma omp parallel num_threads(SimInf_set_num_threads(n))
+    #endif
+    {
+        gsl_vector *work = gsl_vector_alloc(k);
+
+        #ifdef _OPENMP
+        #  pragma omp for
+        #endif
+        for (int i = 0; i < n; i++) {
+            gsl_vector_view v_xx = gsl_vector_view_array(&ptr_xx[i * k], k);
+            double s = 0.0;
+
+            ptr_ww[i] = 0.0;
+            for (int d = 0; d < k; d++) {
+                switch(dist[d]) {
+                case 'g':
+                    ptr_ww[i] +=
+                        dgamma(ptr_xx[i * k + d], ptr_p1[d], 1.0 / ptr_p2[d], 1);
+                    break;
+                case 'n':
+                    ptr_ww[i] +=
+                        dnorm(ptr_xx[i * k + d], ptr_p1[d], ptr_p2[d], 1);
+                    break;
+                case 'u':
+                    ptr_ww[i] +=
+                        dunif(ptr_xx[i * k + d], ptr_p1[d], ptr_p2[d], 1);
+                    break;
+                }
             }
-        }
 
-        if (!R_FINITE(ptr_w[i]) || ptr_w[i] < 0.0) {
-            error = 3;
-            goto cleanup;
-        }
+            for (int j = 0; j < len; j++) {
+                double pdf = 0.0;
+                gsl_vector_view v_x = gsl_vector_view_array(&ptr_x[j * k], k);
 
-        sum = 0.0;
-        for (int j = 0; j < n; j++) {
-            double pdf;
-            gsl_vector_view v_x = gsl_vector_view_array(&ptr_x[j * k], k);
+                if (work) {
+                    gsl_ran_multivariate_gaussian_pdf(
+                        &v_xx.vector, &v_x.vector, L[n_L > 1 ? j : 0],
+                        &pdf, work);
+                }
+
+                s += ptr_w[j] * pdf;
+            }
 
-            gsl_ran_multivariate_gaussian_pdf(&v_xx.vector, &v_x.vector,
-                                              SIGMA, &pdf, work);
+            ptr_ww[i] -= log(s);
+        }
 
-            sum += ptr_w[j] * pdf;
+        if (!work) {
+            #ifdef _OPENMP
+            #  pragma omp atomic write
+            #endif
+            error = 1; /* #nocov */
         }
 
-        sum = log(sum);
-        ptr_ww[i] -= sum;
+        gsl_vector_free(work);
+    }
+
+    if (error)
+        goto cleanup; /* #nocov */
+
+    for (int i = 0; i < n; i++) {
         if (ptr_ww[i] > max_ww)
             max_ww = ptr_ww[i];
     }
@@ -429,8 +798,8 @@ SEXP attribute_hidden SimInf_abc_weights(
         ptr_ww[i] /= sum;
 
 cleanup:
-    gsl_matrix_free(SIGMA);
-    gsl_vector_free(work);
+    SimInf_abc_cholesky_free(L, n_L);
+    free(dist);
 
     if (error)
         SimInf_abc_error(error);
@@ -440,4 +809,330 @@ cleanup:
     return ww;
 }
 
+/**
+ * Check if a symmetric matrix is positive definite by attempting a
+ * Cholesky decomposition.
+ *
+ * @param a the (k x k) matrix in column-major order.
+ * @param k the dimension of the matrix.
+ * @param L work buffer of length k * k for the lower triangular
+ *        factor.
+ * @return 1 if the matrix is numerically positive definite, else 0.
+ */
+static int
+SimInf_abc_posdef(
+    const double *a,
+    int k,
+    double *L)
+{
+    for (int j = 0; j < k; j++) {
+        double sum = a[j * k + j];
+
+        for (int p = 0; p < j; p++)
+            sum -= L[p * k + j] * L[p * k + j];
+        if (!R_FINITE(sum) || sum <= 1e-12 * fabs(a[j * k + j]))
+            return 0;
+        L[j * k + j] = sqrt(sum);
+
+        for (int i = j + 1; i < k; i++) {
+            double v = a[j * k + i];
+
+            for (int p = 0; p < j; p++)
+                v -= L[p * k + i] * L[p * k + j];
+            L[j * k + i] = v / L[j * k + j];
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Compute the optimal local covariance matrix (OLCM) kernel of
+ * Filippi et al. (2013) for each particle in a generation.
+ *
+ * The variance-covariance matrix of the proposal kernel around
+ * particle j is
+ *
+ *   sigma_j = sum_i w_i (x_i - x_j)(x_i - x_j)^T
+ *           = cov_w(x) + (mu - x_j)(mu - x_j)^T
+ *
+ * where the sum is over the particles in 'subset' (normalized
+ * weights), that is, the particles in the generation that would be
+ * accepted also with the tolerance of the next generation, and 'mu'
+ * and 'cov_w' are the weighted mean and covariance of the particles
+ * in 'subset'. The matrices are computed in parallel over the
+ * particles.
+ *
+ * sigma_j is singular if, for example, the subset contains one
+ * particle and x_j is that particle, or if the subset is degenerate
+ * in some direction. A particle with a sigma_j that is not positive
+ * definite falls back to the global normal kernel, i.e., two times
+ * the covariance of all particles in x.
+ *
+ * @param x a numeric matrix (parameters x particles) with the
+ *        generation of particles.
+ * @param w a numeric vector with weights for the particles in x.
+ * @param subset an integer vector with the (one-based) index to the
+ *        particles in x to compute the local covariance from.
+ * @return a numeric array (parameters x parameters x particles).
+ */
+SEXP attribute_hidden SimInf_abc_olcm(
+    SEXP x,
+    SEXP w,
+    SEXP subset)
+{
+    int k = Rf_nrows(x), n = Rf_ncols(x), m = Rf_length(subset);
+    const double *ptr_x = REAL(x), *ptr_w = REAL(w);
+    const int *ptr_subset = INTEGER(subset);
+    double *mu, *cov, *global, *ptr_sigma, sum_w = 0.0;
+    int error = 0;
+    SEXP sigma, dim;
+
+    for (int i = 0; i < m; i++) {
+        if (ptr_subset[i] == NA_INTEGER || ptr_subset[i] < 1 ||
+            ptr_subset[i] > n)
+            Rf_error("'subset' must be an index to the particles.");
+        if (!R_FINITE(ptr_w[ptr_subset[i] - 1]) || ptr_w[ptr_subset[i] - 1] < 0.0)
+            SimInf_abc_error(3);
+        sum_w += ptr_w[ptr_subset[i] - 1];
+    }
+    if (m < 1 || sum_w <= 0.0)
+        Rf_error("'subset' must contain particles with a positive weight.");
+
+    mu = malloc(k * sizeof(double));
+    cov = malloc(k * k * sizeof(double));
+    global = malloc(k * k * sizeof(double));
+    if (!mu || !cov || !global) {
+        free(mu);              /* #nocov */
+        free(cov);             /* #nocov */
+        free(global);          /* #nocov */
+        SimInf_abc_error(1);   /* #nocov */
+    }
+
+    PROTECT(dim = Rf_allocVector(INTSXP, 3));
+    INTEGER(dim)[0] = k;
+    INTEGER(dim)[1] = k;
+    INTEGER(dim)[2] = n;
+    PROTECT(sigma = Rf_allocVector(REALSXP, (R_xlen_t)k * k * n));
+    Rf_setAttrib(sigma, R_DimSymbol, dim);
+    ptr_sigma = REAL(sigma);
+
+    /* The weighted mean of the particles in the subset. */
+    for (int d = 0; d < k; d++) {
+        mu[d] = 0.0;
+        for (int i = 0; i < m; i++) {
+            const int j = ptr_subset[i] - 1;
+            mu[d] += ptr_w[j] * ptr_x[j * k + d];
+        }
+        mu[d] /= sum_w;
+    }
+
+    /* The weighted covariance of the particles in the subset. */
+    for (int d1 = 0; d1 < k; d1++) {
+        for (int d2 = 0; d2 < k; d2++) {
+            cov[d2 * k + d1] = 0.0;
+            for (int i = 0; i < m; i++) {
+                const int j = ptr_subset[i] - 1;
+                cov[d2 * k + d1] += ptr_w[j] *
+                    (ptr_x[j * k + d1] - mu[d1]) *
+                    (ptr_x[j * k + d2] - mu[d2]);
+            }
+            cov[d2 * k + d1] /= sum_w;
+        }
+    }
+
+    /* The global normal kernel: two times the (unweighted) sample
+     * covariance of all particles. */
+    for (int d1 = 0; d1 < k; d1++) {
+        for (int d2 = 0; d2 < k; d2++) {
+            double m1 = 0.0, m2 = 0.0, v = 0.0;
+            for (int j = 0; j < n; j++) {
+                m1 += ptr_x[j * k + d1];
+                m2 += ptr_x[j * k + d2];
+            }
+            m1 /= n;
+            m2 /= n;
+            for (int j = 0; j < n; j++)
+                v += (ptr_x[j * k + d1] - m1) * (ptr_x[j * k + d2] - m2);
+            global[d2 * k + d1] = n > 1 ? 2.0 * v / (n - 1) : 0.0;
+        }
+    }
+
+    #ifdef _OPENMP
+    #  pragma omp parallel num_threads(SimInf_set_num_threads(n))
+    #endif
+    {
+        double *L = malloc(k * k * sizeof(double));
+
+        if (!L) {
+            #ifdef _OPENMP
+            #  pragma omp atomic write
+            #endif
+            error = 1; /* #nocov */
+        }
+
+        #ifdef _OPENMP
+        #  pragma omp for
+        #endif
+        for (int j = 0; j < n; j++) {
+            double *s = &ptr_sigma[(R_xlen_t)j * k * k];
+
+            for (int d1 = 0; d1 < k; d1++) {
+                for (int d2 = 0; d2 < k; d2++) {
+                    s[d2 * k + d1] = cov[d2 * k + d1] +
+                        (mu[d1] - ptr_x[j * k + d1]) *
+                        (mu[d2] - ptr_x[j * k + d2]);
+                }
+            }
+
+            if (L && !SimInf_abc_posdef(s, k, L))
+                memcpy(s, global, k * k * sizeof(double));
+        }
+
+        free(L);
+    }
+
+    free(mu);
+    free(cov);
+    free(global);
+
+    if (error)
+        SimInf_abc_error(error); /* #nocov */
+
+    UNPROTECT(2);
+
+    return sigma;
+}
+
+/**
+ * Predict the probability that proposals are accepted with a
+ * k-nearest neighbour classifier that is trained on previously
+ * simulated proposals and their outcome. The distance between two
+ * particles is the Euclidean distance after scaling each parameter
+ * with its standard deviation in the training data. The predictions
+ * are computed in parallel over the proposals.
+ *
+ * @param x a numeric matrix (parameters x particles) with the
+ *        simulated proposals to train the classifier on.
+ * @param accept a logical vector with the outcome of each particle
+ *        in x.
+ * @param xx a numeric matrix (parameters x particles) with the
+ *        proposals to predict.
+ * @param k the number of nearest neighbours.
+ * @return a numeric vector with the fraction of the k nearest
+ *         neighbours in x that were accepted for each proposal in
+ *         xx.
+ */
+SEXP attribute_hidden SimInf_abc_knn(
+    SEXP x,
+    SEXP accept,
+    SEXP xx,
+    SEXP k)
+{
+    int error = 0, Nk, Nd = Rf_nrows(x), m = Rf_ncols(x), n = Rf_ncols(xx);
+    const double *ptr_x = REAL(x), *ptr_xx = REAL(xx);
+    const int *ptr_accept = LOGICAL(accept);
+    double *scale = NULL, *ptr_p;
+    SEXP p;
+
+    if (SimInf_arg_check_integer_gt_zero(k))
+        Rf_error("'k' must be an integer > 0.");
+    Nk = INTEGER(k)[0];
+    if (Nk > m)
+        Rf_error("'k' must be less than or equal to the number of particles.");
+    if (Rf_nrows(xx) != Nd)
+        Rf_error("'x' and 'xx' must have the same number of parameters.");
+    if (Rf_length(accept) != m)
+        Rf_error("'accept' must have one outcome for each particle in 'x'.");
+    for (int j = 0; j < m; j++) {
+        if (ptr_accept[j] == NA_LOGICAL)
+            Rf_error("'accept' must not contain missing values.");
+    }
+
+    /* Scale each parameter with the inverse of its standard
+     * deviation in the training data. */
+    scale = malloc(Nd * sizeof(double));
+    if (!scale)
+        SimInf_abc_error(1); /* #nocov */
+    for (int d = 0; d < Nd; d++) {
+        double mean = 0.0, var = 0.0;
+
+        for (int j = 0; j < m; j++)
+            mean += ptr_x[j * Nd + d];
+        mean /= m;
+        for (int j = 0; j < m; j++)
+            var += (ptr_x[j * Nd + d] - mean) * (ptr_x[j * Nd + d] - mean);
+        scale[d] = (m > 1 && var > 0.0) ? 1.0 / sqrt(var / (m - 1)) : 1.0;
+    }
+
+    PROTECT(p = Rf_allocVector(REALSXP, n));
+    ptr_p = REAL(p);
+
+    #ifdef _OPENMP
+    #  pragma omp parallel num_threads(SimInf_set_num_threads(n))
+    #endif
+    {
+        /* The distance and outcome of the k nearest neighbours,
+         * sorted by increasing distance. */
+        double *nn_dist = malloc(Nk * sizeof(double));
+        int *nn_accept = malloc(Nk * sizeof(int));
+
+        #ifdef _OPENMP
+        #  pragma omp for
+        #endif
+        for (int i = 0; i < n; i++) {
+            int len = 0, sum = 0;
+
+            if (!nn_dist || !nn_accept)
+                continue; /* #nocov */
+
+            for (int j = 0; j < m; j++) {
+                double dist = 0.0;
+                int pos;
+
+                for (int d = 0; d < Nd; d++) {
+                    const double delta =
+                        (ptr_xx[i * Nd + d] - ptr_x[j * Nd + d]) * scale[d];
+                    dist += delta * delta;
+                }
+
+                if (len == Nk && dist >= nn_dist[Nk - 1])
+                    continue;
+
+                /* Insert the neighbour in sorted order. */
+                pos = len < Nk ? len++ : Nk - 1;
+                for (; pos > 0 && nn_dist[pos - 1] > dist; pos--) {
+                    nn_dist[pos] = nn_dist[pos - 1];
+                    nn_accept[pos] = nn_accept[pos - 1];
+                }
+                nn_dist[pos] = dist;
+                nn_accept[pos] = ptr_accept[j];
+            }
+
+            for (int j = 0; j < len; j++)
+                sum += nn_accept[j];
+            ptr_p[i] = (double)sum / (double)Nk;
+        }
+
+        if (!nn_dist || !nn_accept) {
+            #ifdef _OPENMP
+            #  pragma omp atomic write
+            #endif
+            error = 1; /* #nocov */
+        }
+
+        free(nn_dist);
+        free(nn_accept);
+    }
+
+    free(scale);
+
+    if (error)
+        SimInf_abc_error(error); /* #nocov */
+
+    UNPROTECT(1);
+
+    return p;
+}
+
 #endif
@@ -115,3 +115,27 @@ int attribute_hidden SimInf_sparse(SEXP m, R_xlen_t i, R_xlen_t j)
     int *d = INTEGER(GET_SLOT(m, Rf_install("Dim")));
     return d[0] == i && d[1] == j;
 }
+
+/**
+ * Get a logical setting of the numerical solver.
+ *
+ * Optional settings of the numerical solver are passed from R as
+ * attributes of the 'solver' argument.
+ *
+ * @param solver The 'solver' argument.
+ * @param name The name of the setting.
+ * @return 1 if the setting is TRUE, else 0.
+ */
+int attribute_hidden SimInf_solver_setting_logical(SEXP solver, const char *name)
+{
+    SEXP value;
+
+    if (Rf_isNull(solver))
+        return 0;
+
+    value = Rf_getAttrib(solver, Rf_install(name));
+    if (!Rf_isLogical(value) || Rf_length(value) != 1)
+        return 0;
+
+    return LOGICAL(value)[0] == TRUE;
+}
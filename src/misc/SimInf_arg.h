@@ -33,5 +33,6 @@ int SimInf_arg_check_matrix(SEXP arg);
 int SimInf_arg_check_model(SEXP arg);
 int SimInf_get_solver(int *out, SEXP solver);
 int SimInf_sparse(SEXP m, R_xlen_t i, R_xlen_t j);
+int SimInf_solver_setting_logical(SEXP solver, const char *name);
 
 #endif
@@ -0,0 +1,522 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <R_ext/Visibility.h>
+#include "SimInf.h"
+#include "SimInf_arrow.h"
+
+/**
+ * Release the children and the name of a schema. The schema owns
+ * all its memory, and the release callback can therefore be called
+ * by the consumer from any thread.
+ *
+ * @param schema the schema to release.
+ */
+static void
+SimInf_arrow_schema_release(
+    struct ArrowSchema *schema)
+{
+    if (schema->children) {
+        for (int64_t i = 0; i < schema->n_children; i++) {
+            struct ArrowSchema *child = schema->children[i];
+
+            if (child && child->release)
+                child->release(child);
+            free(child);
+        }
+    }
+
+    free(schema->children);
+    free(schema->private_data);
+    schema->release = NULL;
+}
+
+/**
+ * Release the children and the buffers of an array.
+ *
+ * @param array the array to release.
+ */
+static void
+SimInf_arrow_array_release(
+    struct ArrowArray *array)
+{
+    if (array->children) {
+        for (int64_t i = 0; i < array->n_children; i++) {
+            struct ArrowArray *child = array->children[i];
+
+            if (child && child->release)
+                child->release(child);
+            free(child);
+        }
+    }
+
+    if (array->buffers) {
+        for (int64_t i = 0; i < array->n_buffers; i++)
+            free((void *)array->buffers[i]);
+    }
+
+    free(array->children);
+    free(array->buffers);
+    array->release = NULL;
+}
+
+/**
+ * Initialize a schema with a copy of the name, which is kept in
+ * 'private_data' to be freed on release.
+ *
+ * @return 0 if Ok, else error code.
+ */
+static int
+SimInf_arrow_schema_init(
+    struct ArrowSchema *schema,
+    const char *format,
+    const char *name,
+    int64_t flags)
+{
+    size_t len = strlen(name);
+    char *copy;
+
+    memset(schema, 0, sizeof(struct ArrowSchema));
+    schema->release = &SimInf_arrow_schema_release;
+
+    copy = malloc(len + 1);
+    if (!copy)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    memcpy(copy, name, len + 1);
+
+    schema->format = format;
+    schema->name = copy;
+    schema->flags = flags;
+    schema->private_data = copy;
+
+    return 0;
+}
+
+/**
+ * Initialize an array with 'n_buffers' empty buffers.
+ *
+ * @return 0 if Ok, else error code.
+ */
+static int
+SimInf_arrow_array_init(
+    struct ArrowArray *array,
+    int64_t length,
+    int64_t n_buffers)
+{
+    memset(array, 0, sizeof(struct ArrowArray));
+    array->release = &SimInf_arrow_array_release;
+
+    array->buffers = calloc(n_buffers, sizeof(void *));
+    if (!array->buffers)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    array->length = length;
+    array->n_buffers = n_buffers;
+
+    return 0;
+}
+
+/**
+ * Initialize a struct array, i.e., a record batch, with 'n_children'
+ * columns. The schema and the array of each column are allocated
+ * but not initialized.
+ *
+ * @param schema the schema to initialize.
+ * @param array the array to initialize.
+ * @param n_children the number of columns.
+ * @param length the number of rows.
+ * @return 0 if Ok, else error code. The schema and the array must
+ *         be released by the caller also if an error occurred.
+ */
+int attribute_hidden
+SimInf_arrow_struct(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    int64_t n_children,
+    int64_t length)
+{
+    int error;
+
+    error = SimInf_arrow_schema_init(schema, "+s", "", 0);
+    if (!error)
+        error = SimInf_arrow_array_init(array, length, 1);
+    if (error)
+        return error; /* #nocov */
+
+    schema->children = calloc(n_children, sizeof(struct ArrowSchema *));
+    array->children = calloc(n_children, sizeof(struct ArrowArray *));
+    if (!schema->children || !array->children)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    schema->n_children = n_children;
+    array->n_children = n_children;
+
+    for (int64_t i = 0; i < n_children; i++) {
+        schema->children[i] = calloc(1, sizeof(struct ArrowSchema));
+        array->children[i] = calloc(1, sizeof(struct ArrowArray));
+        if (!schema->children[i] || !array->children[i])
+            return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    }
+
+    return 0;
+}
+
+/**
+ * Initialize a column with fixed width values.
+ *
+ * @param schema the schema of the column.
+ * @param array the array of the column.
+ * @param format the Arrow format string of the values, e.g., "i"
+ *        for int32 and "g" for float64.
+ * @param name the name of the column.
+ * @param length the number of rows.
+ * @param size the size in bytes of each value.
+ * @return a pointer to the buffer of values to fill, or NULL if the
+ *         memory could not be allocated.
+ */
+void attribute_hidden *
+SimInf_arrow_column(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    const char *format,
+    const char *name,
+    int64_t length,
+    size_t size)
+{
+    void *data;
+
+    if (SimInf_arrow_schema_init(schema, format, name, ARROW_FLAG_NULLABLE) ||
+        SimInf_arrow_array_init(array, length, 2)) {
+        return NULL; /* #nocov */
+    }
+
+    /* Make sure to allocate a buffer also for an empty column. */
+    data = malloc(length > 0 ? length * size : 1);
+    array->buffers[1] = data;
+
+    return data;
+}
+
+/**
+ * Mark the missing values (NA) in a column as null in a validity
+ * bitmap. The bitmap is only allocated if the column contains a
+ * missing value.
+ *
+ * @param array the array of the column.
+ * @param is_integer 1 if the values are int32, else float64.
+ * @return 0 if Ok, else error code.
+ */
+int attribute_hidden
+SimInf_arrow_column_nulls(
+    struct ArrowArray *array,
+    int is_integer)
+{
+    const int *p_int = array->buffers[1];
+    const double *p_real = array->buffers[1];
+    int64_t null_count = 0;
+    uint8_t *bitmap;
+
+    for (int64_t i = 0; i < array->length; i++) {
+        if (is_integer ? p_int[i] == NA_INTEGER : ISNA(p_real[i]))
+            null_count++;
+    }
+
+    if (null_count == 0)
+        return 0;
+
+    bitmap = calloc((array->length + 7) / 8, 1);
+    if (!bitmap)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    for (int64_t i = 0; i < array->length; i++) {
+        if (!(is_integer ? p_int[i] == NA_INTEGER : ISNA(p_real[i])))
+            bitmap[i / 8] |= (uint8_t)(1 << (i % 8));
+    }
+
+    array->buffers[0] = bitmap;
+    array->null_count = null_count;
+
+    return 0;
+}
+
+/**
+ * Initialize a large utf8 column from a character vector with
+ * labels, where row i has the label 'labels[index[i]]' translated
+ * to UTF-8. To not translate the label of every row, the labels
+ * should already be in UTF-8, see 'SimInf_arrow_utf8'.
+ *
+ * @param schema the schema of the column.
+ * @param array the array of the column.
+ * @param name the name of the column.
+ * @param labels character vector with the labels.
+ * @param index zero-based index to the label of each row.
+ * @param length the number of rows.
+ * @return 0 if Ok, else error code.
+ */
+int attribute_hidden
+SimInf_arrow_string_column(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    const char *name,
+    SEXP labels,
+    const int *index,
+    int64_t length)
+{
+    int64_t *offsets;
+    char *data;
+    int64_t n = 0;
+
+    if (SimInf_arrow_schema_init(schema, "U", name, ARROW_FLAG_NULLABLE) ||
+        SimInf_arrow_array_init(array, length, 3)) {
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    }
+
+    offsets = malloc((length + 1) * sizeof(int64_t));
+    array->buffers[1] = offsets;
+    if (!offsets)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    offsets[0] = 0;
+    for (int64_t i = 0; i < length; i++) {
+        n += strlen(Rf_translateCharUTF8(STRING_ELT(labels, index[i])));
+        offsets[i + 1] = n;
+    }
+
+    data = malloc(n > 0 ? n : 1);
+    array->buffers[2] = data;
+    if (!data)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    for (int64_t i = 0; i < length; i++) {
+        memcpy(&data[offsets[i]],
+               Rf_translateCharUTF8(STRING_ELT(labels, index[i])),
+               offsets[i + 1] - offsets[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * Translate a character vector to UTF-8, which is the encoding of
+ * the names in a schema and of the values in a utf8 column. The
+ * translation can raise an R error and should therefore be done
+ * before any Arrow structure is allocated.
+ *
+ * @param x a character vector or R_NilValue.
+ * @return a character vector with the strings in 'x' in UTF-8, or
+ *         R_NilValue if 'x' is R_NilValue.
+ */
+SEXP attribute_hidden
+SimInf_arrow_utf8(
+    SEXP x)
+{
+    SEXP result;
+
+    if (Rf_isNull(x))
+        return R_NilValue;
+
+    PROTECT(result = Rf_allocVector(STRSXP, XLENGTH(x)));
+    for (R_xlen_t i = 0; i < XLENGTH(x); i++) {
+        SEXP s = STRING_ELT(x, i);
+
+        if (s == NA_STRING)
+            SET_STRING_ELT(result, i, NA_STRING);
+        else
+            SET_STRING_ELT(result, i, Rf_mkCharCE(Rf_translateCharUTF8(s),
+                                                  CE_UTF8));
+    }
+    UNPROTECT(1);
+
+    return result;
+}
+
+static void
+SimInf_arrow_schema_finalizer(
+    SEXP xptr)
+{
+    struct ArrowSchema *schema = R_ExternalPtrAddr(xptr);
+
+    if (schema) {
+        if (schema->release)
+            schema->release(schema);
+        free(schema);
+        R_ClearExternalPtr(xptr);
+    }
+}
+
+static void
+SimInf_arrow_array_finalizer(
+    SEXP xptr)
+{
+    struct ArrowArray *array = R_ExternalPtrAddr(xptr);
+
+    if (array) {
+        if (array->release)
+            array->release(array);
+        free(array);
+        R_ClearExternalPtr(xptr);
+    }
+}
+
+/**
+ * Wrap a schema and an array in external pointers. A consumer can
+ * move the structures, i.e., take ownership by copying them and
+ * setting the release callback to NULL. Otherwise the structures
+ * are released when the external pointers are garbage collected.
+ *
+ * @param schema a schema allocated with malloc.
+ * @param array an array allocated with malloc.
+ * @return a list with the external pointers 'schema' and 'array'.
+ */
+SEXP attribute_hidden
+SimInf_arrow_xptr(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array)
+{
+    SEXP result, names, xptr;
+
+    PROTECT(result = Rf_allocVector(VECSXP, 2));
+    PROTECT(names = Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(names, 0, Rf_mkChar("schema"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("array"));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+
+    SET_VECTOR_ELT(result, 0, xptr = R_MakeExternalPtr(
+                       schema, Rf_install("arrow_schema"), R_NilValue));
+    R_RegisterCFinalizerEx(xptr, SimInf_arrow_schema_finalizer, TRUE);
+    SET_VECTOR_ELT(result, 1, xptr = R_MakeExternalPtr(
+                       array, Rf_install("arrow_array"), R_NilValue));
+    R_RegisterCFinalizerEx(xptr, SimInf_arrow_array_finalizer, TRUE);
+
+    UNPROTECT(2);
+
+    return result;
+}
+
+/**
+ * Check if a value in a column is valid, i.e., not null.
+ *
+ * @param array the array of the column.
+ * @param i the row.
+ * @return 1 if the value is valid, else 0.
+ */
+static int
+SimInf_arrow_is_valid(
+    const struct ArrowArray *array,
+    int64_t i)
+{
+    const uint8_t *bitmap = array->buffers[0];
+
+    i += array->offset;
+    return bitmap == NULL || ((bitmap[i / 8] >> (i % 8)) & 1);
+}
+
+/**
+ * Read the columns of an exported struct array into a list, to
+ * check the exported data against the data.frame from the
+ * trajectory. The format, the values, the validity bitmap and the
+ * null count of every column are checked, and a null is read as NA.
+ *
+ * @param schema external pointer to an ArrowSchema of type struct.
+ * @param array external pointer to the ArrowArray of the schema.
+ * @return a named list with one vector for each column.
+ */
+SEXP attribute_hidden
+SimInf_arrow_read(
+    SEXP schema,
+    SEXP array)
+{
+    const struct ArrowSchema *s = R_ExternalPtrAddr(schema);
+    const struct ArrowArray *a = R_ExternalPtrAddr(array);
+    SEXP result, names;
+
+    if (!s || !a || !s->release || !a->release ||
+        strcmp(s->format, "+s") != 0 || s->n_children != a->n_children)
+        Rf_error("Invalid Arrow struct array.");
+
+    PROTECT(result = Rf_allocVector(VECSXP, s->n_children));
+    PROTECT(names = Rf_allocVector(STRSXP, s->n_children));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+
+    for (int64_t j = 0; j < s->n_children; j++) {
+        const struct ArrowSchema *cs = s->children[j];
+        const struct ArrowArray *ca = a->children[j];
+        int64_t null_count = 0;
+        SEXP vec;
+
+        if (ca->length != a->length)
+            Rf_error("Invalid length of column '%s'.", cs->name);
+        SET_STRING_ELT(names, j, Rf_mkCharCE(cs->name, CE_UTF8));
+
+        if (strcmp(cs->format, "i") == 0 && ca->n_buffers == 2) {
+            const int *x = ca->buffers[1];
+
+            SET_VECTOR_ELT(result, j, vec = Rf_allocVector(INTSXP, ca->length));
+            for (int64_t i = 0; i < ca->length; i++) {
+                if (SimInf_arrow_is_valid(ca, i)) {
+                    INTEGER(vec)[i] = x[ca->offset + i];
+                } else {
+                    INTEGER(vec)[i] = NA_INTEGER;
+                    null_count++;
+                }
+            }
+        } else if (strcmp(cs->format, "g") == 0 && ca->n_buffers == 2) {
+            const double *x = ca->buffers[1];
+
+            SET_VECTOR_ELT(result, j, vec = Rf_allocVector(REALSXP, ca->length));
+            for (int64_t i = 0; i < ca->length; i++) {
+                if (SimInf_arrow_is_valid(ca, i)) {
+                    REAL(vec)[i] = x[ca->offset + i];
+                } else {
+                    REAL(vec)[i] = NA_REAL;
+                    null_count++;
+                }
+            }
+        } else if (strcmp(cs->format, "U") == 0 && ca->n_buffers == 3) {
+            const int64_t *offsets = ca->buffers[1];
+            const char *data = ca->buffers[2];
+
+            SET_VECTOR_ELT(result, j, vec = Rf_allocVector(STRSXP, ca->length));
+            for (int64_t i = 0; i < ca->length; i++) {
+                const int64_t k = ca->offset + i;
+
+                if (SimInf_arrow_is_valid(ca, i)) {
+                    SET_STRING_ELT(vec, i, Rf_mkCharLenCE(
+                                       &data[offsets[k]],
+                                       offsets[k + 1] - offsets[k],
+                                       CE_UTF8));
+                } else {
+                    SET_STRING_ELT(vec, i, NA_STRING);
+                    null_count++;
+                }
+            }
+        } else {
+            Rf_error("Invalid format of column '%s'.", cs->name);
+        }
+
+        if (null_count != ca->null_count)
+            Rf_error("Invalid null count of column '%s'.", cs->name);
+    }
+
+    UNPROTECT(2);
+
+    return result;
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_SIMINF_ARROW_H
+#define INCLUDE_SIMINF_ARROW_H
+
+#include <stdint.h>
+#include <Rinternals.h>
+
+/* The structures of the Arrow C data interface, see
+ * https://arrow.apache.org/docs/format/CDataInterface.html. The
+ * definitions are ABI stable and are copied from the specification,
+ * such that no Arrow library is required. */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif
+
+int SimInf_arrow_struct(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    int64_t n_children,
+    int64_t length);
+
+void *SimInf_arrow_column(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    const char *format,
+    const char *name,
+    int64_t length,
+    size_t size);
+
+int SimInf_arrow_column_nulls(
+    struct ArrowArray *array,
+    int is_integer);
+
+int SimInf_arrow_string_column(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    const char *name,
+    SEXP labels,
+    const int *index,
+    int64_t length);
+
+SEXP SimInf_arrow_utf8(
+    SEXP x);
+
+SEXP SimInf_arrow_xptr(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array);
+
+SEXP SimInf_arrow_read(
+    SEXP schema,
+    SEXP array);
+
+#endif
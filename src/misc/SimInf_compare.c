@@ -0,0 +1,424 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <Rdefines.h>
+#include <R_ext/Visibility.h>
+#include <math.h>
+#include <stdlib.h>
+#include "SimInf.h"
+#include "SimInf_arg.h"
+#include "SimInf_openmp.h"
+
+/* The errors when comparing the trajectories. */
+#define SIMINF_COMPARE_ERR_ALLOC        1
+#define SIMINF_COMPARE_ERR_COMPARTMENTS 2
+#define SIMINF_COMPARE_ERR_ID           3
+
+/**
+ * The discrete state of one of the two trajectories to compare.
+ */
+typedef struct SimInf_compare_U
+{
+    const int *dense;     /**< The dense data, or NULL if sparse. */
+    int cmajor;           /**< 1 if the dense data is ordered
+                           *   compartment-major, else 0. */
+    const int *ir;        /**< Row indices of the sparse data. */
+    const int *jc;        /**< Column pointers of the sparse data. */
+    const double *x;      /**< Values of the sparse data. */
+} SimInf_compare_U;
+
+/**
+ * The selection of the data to compare.
+ */
+typedef struct SimInf_compare_data
+{
+    int Nn;               /**< Number of nodes in the model. */
+    int Nc;               /**< Number of compartments in each node. */
+    int n_cmp;            /**< Number of selected compartments. */
+    const int *cmp;       /**< Index (0-based) to the selected
+                           *   compartments. */
+    int *selected;        /**< Nc flags that are 1 for a selected
+                           *   compartment. */
+    R_xlen_t id_len;      /**< Number of nodes to compare. */
+    int *id;              /**< Index (0-based) to the nodes to
+                           *   compare. */
+    int *pos;             /**< Nn positions of each node in 'id', or
+                           *   -1 if the node is not compared. */
+} SimInf_compare_data;
+
+/**
+ * Initialize the discrete state of a trajectory.
+ *
+ * @param m The dense integer matrix or the dgCMatrix with the data.
+ * @param cmajor 1 if a dense 'm' is ordered compartment-major.
+ * @param Nrow The expected number of rows in 'm'.
+ * @param tlen The expected number of columns in 'm'.
+ * @param u The discrete state to initialize.
+ * @return 0 if Ok, else -1.
+ */
+static int
+SimInf_compare_U_init(
+    SEXP m,
+    int cmajor,
+    R_xlen_t Nrow,
+    R_xlen_t tlen,
+    SimInf_compare_U *u)
+{
+    if (Rf_isMatrix(m) && Rf_isInteger(m)) {
+        if ((R_xlen_t)Rf_nrows(m) != Nrow || (R_xlen_t)Rf_ncols(m) != tlen)
+            return -1;
+        u->dense = INTEGER(m);
+        u->cmajor = cmajor;
+        return 0;
+    }
+
+    if (SimInf_arg_check_dgCMatrix(m))
+        return -1;
+    if ((R_xlen_t)INTEGER(GET_SLOT(m, Rf_install("Dim")))[0] != Nrow ||
+        (R_xlen_t)INTEGER(GET_SLOT(m, Rf_install("Dim")))[1] != tlen)
+        return -1;
+    u->ir = INTEGER(GET_SLOT(m, Rf_install("i")));
+    u->jc = INTEGER(GET_SLOT(m, Rf_install("p")));
+    u->x = REAL(GET_SLOT(m, Rf_install("x")));
+
+    return 0;
+}
+
+/**
+ * Sum the selected compartments in each compared node at one time
+ * point.
+ *
+ * A node that is not recorded in every selected compartment in
+ * sparse data is missing (NA).
+ *
+ * @param d The selection of the data to compare.
+ * @param u The discrete state of the trajectory.
+ * @param t The index to the time point.
+ * @param val The sum in each of the 'id_len' nodes.
+ * @param cnt Buffer with 'id_len' counters for sparse data.
+ */
+static void
+SimInf_compare_column(
+    const SimInf_compare_data *d,
+    const SimInf_compare_U *u,
+    R_xlen_t t,
+    double *val,
+    int *cnt)
+{
+    if (u->dense) {
+        const int *col = &u->dense[t * d->Nn * d->Nc];
+
+        #ifdef _OPENMP
+        #  pragma omp for
+        #endif
+        for (R_xlen_t i = 0; i < d->id_len; i++) {
+            const R_xlen_t node = d->id[i];
+            double sum = 0.0;
+
+            for (int k = 0; k < d->n_cmp; k++) {
+                if (u->cmajor)
+                    sum += col[(R_xlen_t)d->cmp[k] * d->Nn + node];
+                else
+                    sum += col[node * d->Nc + d->cmp[k]];
+            }
+
+            val[i] = sum;
+        }
+
+        return;
+    }
+
+    #ifdef _OPENMP
+    #  pragma omp single
+    #endif
+    {
+        for (R_xlen_t i = 0; i < d->id_len; i++) {
+            val[i] = 0.0;
+            cnt[i] = 0;
+        }
+
+        for (int j = u->jc[t]; j < u->jc[t + 1]; j++) {
+            const int node = u->ir[j] / d->Nc;
+            const int c = u->ir[j] % d->Nc;
+
+            if (d->selected[c] && d->pos[node] >= 0) {
+                val[d->pos[node]] += u->x[j];
+                cnt[d->pos[node]]++;
+            }
+        }
+
+        for (R_xlen_t i = 0; i < d->id_len; i++) {
+            if (cnt[i] < d->n_cmp)
+                val[i] = NA_REAL;
+        }
+    }
+}
+
+/**
+ * Compare the discrete state of two simulated trajectories.
+ *
+ * The trajectories are compared in a single pass over the time
+ * points, without creating the trajectory of either model. At each
+ * time point, the sum of the selected compartments in each node is
+ * computed for the baseline and the intervention, and the per-node
+ * summaries are updated in parallel. A node and time point is only
+ * compared if it is recorded in both trajectories.
+ *
+ * @param baseline The discrete state (dense integer matrix or
+ *        dgCMatrix) of the baseline trajectory.
+ * @param intervention The discrete state (dense integer matrix or
+ *        dgCMatrix) of the intervention trajectory.
+ * @param layout Logical vector of length two that is TRUE if the
+ *        dense 'baseline' and 'intervention' are ordered
+ *        compartment-major.
+ * @param compartments Index (1-based) to the compartments to sum.
+ * @param Nc The number of compartments in each node.
+ * @param tspan The time points of the trajectories.
+ * @param id_n The number of nodes in the model.
+ * @param id NULL or an integer vector with (1-based) indices of the
+ *        nodes to compare.
+ * @return A list with the per-node vectors 'baseline' and
+ *         'intervention' (the sum over the time points),
+ *         'max_difference' (the maximum absolute difference),
+ *         'extinction_baseline' and 'extinction_intervention' (the
+ *         first time point from which the sum is zero after it was
+ *         positive, or NA if the sum is not zero at the last time
+ *         point or never was positive), and
+ *         'dominance' (1 if the intervention is less than or equal
+ *         to the baseline at every time point and less at some time
+ *         point, -1 if the reverse holds, else 0), and the per time
+ *         point vectors 'time_baseline' and 'time_intervention' (the
+ *         sum over the nodes).
+ */
+SEXP attribute_hidden
+SimInf_compare(
+    SEXP baseline,
+    SEXP intervention,
+    SEXP layout,
+    SEXP compartments,
+    SEXP Nc,
+    SEXP tspan,
+    SEXP id_n,
+    SEXP id)
+{
+    const char *names[] = {"baseline", "intervention", "max_difference",
+                           "extinction_baseline", "extinction_intervention",
+                           "dominance", "time_baseline",
+                           "time_intervention", ""};
+    SimInf_compare_data d = {0};
+    SimInf_compare_U ub = {0}, ui = {0};
+    SEXP result;
+    R_xlen_t tlen;
+    double *vb = NULL, *vi = NULL;
+    int *cb = NULL, *ci = NULL, *eb = NULL, *ei = NULL, *flags = NULL;
+    double *sum_b, *sum_i, *max_diff, *ext_b, *ext_i, *t_b, *t_i;
+    int *dominance;
+    double tot_b = 0.0, tot_i = 0.0;
+    int error = 0;
+
+    if (!Rf_isInteger(compartments) || !Rf_isInteger(Nc) || LENGTH(Nc) != 1 ||
+        !Rf_isInteger(id_n) || LENGTH(id_n) != 1 || !Rf_isReal(tspan) ||
+        !Rf_isLogical(layout) || LENGTH(layout) != 2)
+        Rf_error("Invalid arguments to compare the trajectories.");
+
+    d.Nc = INTEGER(Nc)[0];
+    d.Nn = INTEGER(id_n)[0];
+    d.n_cmp = LENGTH(compartments);
+    d.cmp = INTEGER(compartments);
+    d.id_len = Rf_isNull(id) ? d.Nn : XLENGTH(id);
+    tlen = XLENGTH(tspan);
+
+    if (SimInf_compare_U_init(baseline, LOGICAL(layout)[0] == TRUE,
+                              (R_xlen_t)d.Nn * d.Nc, tlen, &ub) ||
+        SimInf_compare_U_init(intervention, LOGICAL(layout)[1] == TRUE,
+                              (R_xlen_t)d.Nn * d.Nc, tlen, &ui))
+        Rf_error("The trajectories to compare must have the same dimensions.");
+
+    PROTECT(result = Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(result, 0, Rf_allocVector(REALSXP, d.id_len));
+    SET_VECTOR_ELT(result, 1, Rf_allocVector(REALSXP, d.id_len));
+    SET_VECTOR_ELT(result, 2, Rf_allocVector(REALSXP, d.id_len));
+    SET_VECTOR_ELT(result, 3, Rf_allocVector(REALSXP, d.id_len));
+    SET_VECTOR_ELT(result, 4, Rf_allocVector(REALSXP, d.id_len));
+    SET_VECTOR_ELT(result, 5, Rf_allocVector(INTSXP, d.id_len));
+    SET_VECTOR_ELT(result, 6, Rf_allocVector(REALSXP, tlen));
+    SET_VECTOR_ELT(result, 7, Rf_allocVector(REALSXP, tlen));
+    sum_b = REAL(VECTOR_ELT(result, 0));
+    sum_i = REAL(VECTOR_ELT(result, 1));
+    max_diff = REAL(VECTOR_ELT(result, 2));
+    ext_b = REAL(VECTOR_ELT(result, 3));
+    ext_i = REAL(VECTOR_ELT(result, 4));
+    dominance = INTEGER(VECTOR_ELT(result, 5));
+    t_b = REAL(VECTOR_ELT(result, 6));
+    t_i = REAL(VECTOR_ELT(result, 7));
+
+    d.selected = calloc(d.Nc, sizeof(int));
+    d.id = malloc(d.id_len * sizeof(int));
+    d.pos = malloc(d.Nn * sizeof(int));
+    vb = malloc(d.id_len * sizeof(double));
+    vi = malloc(d.id_len * sizeof(double));
+    cb = malloc(d.id_len * sizeof(int));
+    ci = malloc(d.id_len * sizeof(int));
+    eb = malloc(d.id_len * sizeof(int));
+    ei = malloc(d.id_len * sizeof(int));
+    flags = calloc(d.id_len, sizeof(int));
+    if (!d.selected || !d.id || !d.pos || !vb || !vi || !cb || !ci ||
+        !eb || !ei || !flags) {
+        error = SIMINF_COMPARE_ERR_ALLOC; /* #nocov */
+        goto cleanup;                     /* #nocov */
+    }
+
+    for (int k = 0; k < d.n_cmp; k++) {
+        if (d.cmp[k] == NA_INTEGER || d.cmp[k] < 1 || d.cmp[k] > d.Nc) {
+            error = SIMINF_COMPARE_ERR_COMPARTMENTS;
+            goto cleanup;
+        }
+        d.selected[d.cmp[k] - 1] = 1;
+    }
+    d.n_cmp = 0;
+    for (int c = 0; c < d.Nc; c++) {
+        if (d.selected[c])
+            d.n_cmp++;
+    }
+
+    for (int j = 0; j < d.Nn; j++)
+        d.pos[j] = -1;
+    for (R_xlen_t i = 0; i < d.id_len; i++) {
+        const int node = Rf_isNull(id) ? (int)i : INTEGER(id)[i] - 1;
+
+        if (node < 0 || node >= d.Nn || d.pos[node] >= 0) {
+            error = SIMINF_COMPARE_ERR_ID;
+            goto cleanup;
+        }
+        d.id[i] = node;
+        d.pos[node] = i;
+    }
+
+    /* The selected compartments as a sorted 0-based index. */
+    {
+        int *cmp = (int *)R_alloc(d.n_cmp, sizeof(int));
+        int k = 0;
+
+        for (int c = 0; c < d.Nc; c++) {
+            if (d.selected[c])
+                cmp[k++] = c;
+        }
+        d.cmp = cmp;
+    }
+
+    for (R_xlen_t i = 0; i < d.id_len; i++) {
+        sum_b[i] = 0.0;
+        sum_i[i] = 0.0;
+        max_diff[i] = NA_REAL;
+        eb[i] = -2;
+        ei[i] = -2;
+    }
+
+    /* Use all available threads in parallel regions. */
+    SimInf_set_num_threads(-1);
+
+    #ifdef _OPENMP
+    #  pragma omp parallel num_threads(SimInf_num_threads())
+    #endif
+    {
+        for (R_xlen_t t = 0; t < tlen; t++) {
+            SimInf_compare_column(&d, &ub, t, vb, cb);
+            SimInf_compare_column(&d, &ui, t, vi, ci);
+
+            #ifdef _OPENMP
+            #  pragma omp for reduction(+:tot_b, tot_i)
+            #endif
+            for (R_xlen_t i = 0; i < d.id_len; i++) {
+                const double b = vb[i], v = vi[i];
+
+                if (ISNAN(b) || ISNAN(v))
+                    continue;
+
+                sum_b[i] += b;
+                sum_i[i] += v;
+                tot_b += b;
+                tot_i += v;
+
+                if (ISNAN(max_diff[i]) || fabs(v - b) > max_diff[i])
+                    max_diff[i] = fabs(v - b);
+
+                /* The first time point of the last run of zeros
+                 * after a positive sum: -2 until the sum is
+                 * positive, then -1 while it is positive. */
+                if (b > 0)
+                    eb[i] = -1;
+                else if (eb[i] == -1)
+                    eb[i] = t;
+                if (v > 0)
+                    ei[i] = -1;
+                else if (ei[i] == -1)
+                    ei[i] = t;
+
+                /* Bit 1: the intervention is less than the baseline,
+                 * bit 2: the intervention is greater. */
+                if (v < b)
+                    flags[i] |= 1;
+                else if (v > b)
+                    flags[i] |= 2;
+            }
+
+            #ifdef _OPENMP
+            #  pragma omp single
+            #endif
+            {
+                t_b[t] = tot_b;
+                t_i[t] = tot_i;
+                tot_b = 0.0;
+                tot_i = 0.0;
+            }
+        }
+    }
+
+    for (R_xlen_t i = 0; i < d.id_len; i++) {
+        ext_b[i] = eb[i] < 0 ? NA_REAL : REAL(tspan)[eb[i]];
+        ext_i[i] = ei[i] < 0 ? NA_REAL : REAL(tspan)[ei[i]];
+        dominance[i] = flags[i] == 1 ? 1 : (flags[i] == 2 ? -1 : 0);
+    }
+
+cleanup:
+    free(d.selected);
+    free(d.id);
+    free(d.pos);
+    free(vb);
+    free(vi);
+    free(cb);
+    free(ci);
+    free(eb);
+    free(ei);
+    free(flags);
+
+    UNPROTECT(1);
+
+    switch (error) {
+    case SIMINF_COMPARE_ERR_ALLOC:
+        Rf_error("Unable to allocate memory buffer."); /* #nocov */
+    case SIMINF_COMPARE_ERR_COMPARTMENTS:
+        Rf_error("'compartments' must be an index to the compartments.");
+    case SIMINF_COMPARE_ERR_ID:
+        Rf_error("'id' must be a unique index to the nodes.");
+    }
+
+    return result;
+}
@@ -23,6 +23,8 @@
 
 #include <R_ext/Visibility.h>
 
+#include "SimInf.h"
+
 /**
  * Local spread of the environmental infectious pressure phi among
  * proximal nodes.
@@ -39,7 +41,7 @@
  * pressure phi among proximal nodes.
  * @return The contribution from neighbors to phi in node i
  */
-double attribute_hidden SimInf_local_spread(
+double attribute_hidden SIMINF_TARGET_CLONES SimInf_local_spread(
     const double *neighbors,
     const double *phi,
     const int *u,
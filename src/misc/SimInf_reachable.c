@@ -0,0 +1,372 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <Rdefines.h>
+#include <R_ext/Visibility.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "SimInf.h"
+#include "SimInf_arg.h"
+
+/* The external transfer event type. */
+#define SIMINF_REACHABLE_EXTERNAL_TRANSFER 3
+
+/* The enter event type. */
+#define SIMINF_REACHABLE_ENTER 1
+
+/**
+ * The scheduled events and the spatial coupling that are used to
+ * determine the reachable nodes.
+ */
+typedef struct SimInf_reachable_data
+{
+    R_xlen_t len;         /**< Number of scheduled events. */
+    const int *event;     /**< The type of each event. */
+    const int *time;      /**< The time of each event. */
+    const int *node;      /**< The node (one-based) of each event. */
+    const int *dest;      /**< The dest (one-based) of each event. */
+    const int *period;    /**< The period of each event, or NULL. */
+    const int *end;       /**< The end of each event, or NULL. */
+    int horizon;          /**< The last time in tspan. */
+    const int *ir;        /**< Row indices of the distance matrix. */
+    const int *jc;        /**< Column pointers of the distance
+                           *   matrix, or NULL. */
+    int *stack;           /**< Buffer with Nn nodes to traverse the
+                           *   spatial neighbours. */
+} SimInf_reachable_data;
+
+/**
+ * Determine the first occurrence of an event at or after a time.
+ *
+ * @param d The data with the scheduled events.
+ * @param i The index of the event.
+ * @param t The time.
+ * @return the time of the first occurrence >= t, or INT_MAX if the
+ *         event does not occur at or after t within the horizon.
+ */
+static int SimInf_reachable_first(
+    const SimInf_reachable_data *d,
+    R_xlen_t i,
+    int t)
+{
+    long long occurrence = d->time[i];
+    long long last = d->time[i];
+
+    if (d->period && d->period[i] > 0) {
+        last = d->end[i];
+        if (occurrence < t)
+            occurrence += ((t - occurrence + d->period[i] - 1) / d->period[i]) *
+                (long long)d->period[i];
+    }
+
+    if (last > d->horizon)
+        last = d->horizon;
+    if (occurrence < t || occurrence > last)
+        return INT_MAX;
+    return (int)occurrence;
+}
+
+/**
+ * Determine the last occurrence of an event at or before a time.
+ *
+ * @param d The data with the scheduled events.
+ * @param i The index of the event.
+ * @param t The time.
+ * @return the time of the last occurrence <= t, or INT_MIN if the
+ *         event does not occur at or before t within the horizon.
+ */
+static int SimInf_reachable_last(
+    const SimInf_reachable_data *d,
+    R_xlen_t i,
+    int t)
+{
+    long long occurrence = d->time[i];
+
+    if (t > d->horizon)
+        t = d->horizon;
+    if (occurrence > t)
+        return INT_MIN;
+
+    if (d->period && d->period[i] > 0) {
+        long long last = d->end[i] < t ? d->end[i] : t;
+        occurrence += ((last - occurrence) / d->period[i]) *
+            (long long)d->period[i];
+    }
+
+    return (int)occurrence;
+}
+
+/**
+ * Propagate a time to the spatial neighbours of a node, and
+ * transitively to their neighbours.
+ *
+ * @param d The data with the spatial coupling.
+ * @param value The time of each node.
+ * @param node The node (zero-based) to start from.
+ * @param forward If non-zero, a neighbour is updated if the time of
+ *        the node is earlier, else if it is later.
+ * @return the number of updated nodes.
+ */
+static int SimInf_reachable_spatial(
+    SimInf_reachable_data *d,
+    int *value,
+    int node,
+    int forward)
+{
+    int n = 0, updated = 0;
+
+    if (!d->jc)
+        return 0;
+
+    d->stack[n++] = node;
+    while (n > 0) {
+        const int j = d->stack[--n];
+
+        for (int k = d->jc[j]; k < d->jc[j + 1]; k++) {
+            const int i = d->ir[k];
+
+            if (forward ? value[j] < value[i] : value[j] > value[i]) {
+                value[i] = value[j];
+                d->stack[n++] = i;
+                updated++;
+            }
+        }
+    }
+
+    return updated;
+}
+
+/**
+ * Determine the nodes that must be simulated to get the result for
+ * the nodes that can be reached from the nodes with individuals in
+ * the seed compartments.
+ *
+ * A node is reachable if it has individuals in a seed compartment in
+ * 'u0', if an enter event adds individuals to a seed compartment, if
+ * an external transfer event moves individuals to it from a reachable
+ * node at or after the time when that node was reached, or if it is a
+ * spatial neighbour of a reachable node. The search is repeated over
+ * the events until no more nodes are reached, which handles the
+ * recurring events.
+ *
+ * The reachable nodes also depend on the nodes that move individuals
+ * to them. Therefore, a node that moves individuals to a reachable
+ * node, or to another such node before its last transfer, is also
+ * simulated. All other nodes are unaffected by the seeds and can be
+ * pruned.
+ *
+ * @param model The SimInf_model.
+ * @param compartments Integer vector with the (one-based) seed
+ *        compartments.
+ * @param distance Sparse matrix (dgCMatrix) with the spatial
+ *        coupling between nodes, or NULL.
+ * @return an integer vector with the status of each node: 0) pruned,
+ *         1) reachable, and 2) simulated since it moves individuals
+ *         to reachable nodes.
+ */
+SEXP attribute_hidden SimInf_reachable(
+    SEXP model,
+    SEXP compartments,
+    SEXP distance)
+{
+    SEXP u0, events, E, N, tspan, result;
+    SimInf_reachable_data d = {0};
+    int *reach = NULL, *need = NULL, *seed = NULL, *status;
+    const int *u, *irE, *jcE, *select, *shift, *ptr_N = NULL;
+    int Nc, Nn, changed;
+
+    if (SimInf_arg_check_model(model))
+        Rf_error("Invalid model.");
+    if (!Rf_isInteger(compartments))
+        Rf_error("'compartments' must be an integer vector.");
+    if (!Rf_isNull(distance) && SimInf_arg_check_dgCMatrix(distance))
+        Rf_error("Invalid 'distance' argument.");
+
+    u0 = GET_SLOT(model, Rf_install("u0"));
+    u = INTEGER(u0);
+    Nc = Rf_nrows(u0);
+    Nn = Rf_ncols(u0);
+
+    if (!Rf_isNull(distance) &&
+        LENGTH(GET_SLOT(distance, Rf_install("p"))) - 1 != Nn)
+        Rf_error("The number of nodes in 'model' and 'distance' are not equal.");
+
+    tspan = GET_SLOT(model, Rf_install("tspan"));
+    d.horizon = (int)REAL(tspan)[LENGTH(tspan) - 1];
+
+    events = GET_SLOT(model, Rf_install("events"));
+    d.len = XLENGTH(GET_SLOT(events, Rf_install("event")));
+    d.event = INTEGER(GET_SLOT(events, Rf_install("event")));
+    d.time = INTEGER(GET_SLOT(events, Rf_install("time")));
+    d.node = INTEGER(GET_SLOT(events, Rf_install("node")));
+    d.dest = INTEGER(GET_SLOT(events, Rf_install("dest")));
+    select = INTEGER(GET_SLOT(events, Rf_install("select")));
+    shift = INTEGER(GET_SLOT(events, Rf_install("shift")));
+    if (XLENGTH(GET_SLOT(events, Rf_install("period")))) {
+        d.period = INTEGER(GET_SLOT(events, Rf_install("period")));
+        d.end = INTEGER(GET_SLOT(events, Rf_install("end")));
+    }
+
+    E = GET_SLOT(events, Rf_install("E"));
+    irE = INTEGER(GET_SLOT(E, Rf_install("i")));
+    jcE = INTEGER(GET_SLOT(E, Rf_install("p")));
+    N = GET_SLOT(events, Rf_install("N"));
+    if (Rf_nrows(N) > 0)
+        ptr_N = INTEGER(N);
+
+    if (!Rf_isNull(distance)) {
+        d.ir = INTEGER(GET_SLOT(distance, Rf_install("i")));
+        d.jc = INTEGER(GET_SLOT(distance, Rf_install("p")));
+    }
+
+    reach = malloc(Nn * sizeof(int));
+    need = malloc(Nn * sizeof(int));
+    seed = calloc(Nc, sizeof(int));
+    d.stack = malloc(Nn * sizeof(int));
+    if (!reach || !need || !seed || !d.stack) {
+        free(reach);                                   /* #nocov */
+        free(need);                                    /* #nocov */
+        free(seed);                                    /* #nocov */
+        free(d.stack);                                 /* #nocov */
+        Rf_error("Unable to allocate memory buffer."); /* #nocov */
+    }
+
+    for (int i = 0; i < LENGTH(compartments); i++) {
+        const int c = INTEGER(compartments)[i];
+
+        if (c == NA_INTEGER || c < 1 || c > Nc) {
+            free(reach);
+            free(need);
+            free(seed);
+            free(d.stack);
+            Rf_error("'compartments' must be an index to the compartments.");
+        }
+        seed[c - 1] = 1;
+    }
+
+    /* The nodes with individuals in the seed compartments are
+     * reachable from the start. */
+    for (int j = 0; j < Nn; j++) {
+        reach[j] = INT_MAX;
+        need[j] = INT_MIN;
+        for (int c = 0; c < Nc; c++) {
+            if (seed[c] && u[(R_xlen_t)j * Nc + c] > 0)
+                reach[j] = INT_MIN;
+        }
+    }
+    for (int j = 0; j < Nn; j++) {
+        if (reach[j] == INT_MIN)
+            SimInf_reachable_spatial(&d, reach, j, 1);
+    }
+
+    /* Forward search from the seeds through the events in time
+     * order. */
+    do {
+        changed = 0;
+
+        for (R_xlen_t i = 0; i < d.len; i++) {
+            const int node = d.node[i] - 1;
+            int t;
+
+            if (node < 0)
+                continue;
+
+            if (d.event[i] == SIMINF_REACHABLE_ENTER) {
+                int seeded = 0;
+
+                /* Check if the event adds individuals to a seed
+                 * compartment. */
+                for (int k = jcE[select[i] - 1]; k < jcE[select[i]]; k++) {
+                    const int c = irE[k];
+
+                    if (seed[c])
+                        seeded = 1;
+                    if (ptr_N && shift[i] > 0) {
+                        const int cc = c + ptr_N[(shift[i] - 1) * Nc + c];
+
+                        if (cc >= 0 && cc < Nc && seed[cc])
+                            seeded = 1;
+                    }
+                }
+
+                t = seeded ? SimInf_reachable_first(&d, i, INT_MIN) : INT_MAX;
+                if (t < reach[node]) {
+                    reach[node] = t;
+                    SimInf_reachable_spatial(&d, reach, node, 1);
+                    changed = 1;
+                }
+            } else if (d.event[i] == SIMINF_REACHABLE_EXTERNAL_TRANSFER &&
+                       reach[node] < INT_MAX) {
+                const int dest = d.dest[i] - 1;
+
+                t = SimInf_reachable_first(&d, i, reach[node]);
+                if (t < reach[dest]) {
+                    reach[dest] = t;
+                    SimInf_reachable_spatial(&d, reach, dest, 1);
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+
+    /* Backward search from the reachable nodes through the external
+     * transfer events in reverse time order. */
+    for (int j = 0; j < Nn; j++) {
+        if (reach[j] < INT_MAX)
+            need[j] = INT_MAX;
+    }
+
+    do {
+        changed = 0;
+
+        for (R_xlen_t i = d.len - 1; i >= 0; i--) {
+            if (d.event[i] == SIMINF_REACHABLE_EXTERNAL_TRANSFER) {
+                const int node = d.node[i] - 1;
+                const int dest = d.dest[i] - 1;
+                const int t = SimInf_reachable_last(&d, i, need[dest]);
+
+                if (t > need[node]) {
+                    need[node] = t;
+                    SimInf_reachable_spatial(&d, need, node, 0);
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+
+    PROTECT(result = Rf_allocVector(INTSXP, Nn));
+    status = INTEGER(result);
+    for (int j = 0; j < Nn; j++) {
+        if (reach[j] < INT_MAX)
+            status[j] = 1;
+        else if (need[j] > INT_MIN)
+            status[j] = 2;
+        else
+            status[j] = 0;
+    }
+
+    free(reach);
+    free(need);
+    free(seed);
+    free(d.stack);
+    UNPROTECT(1);
+
+    return result;
+}
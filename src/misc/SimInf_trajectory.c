@@ -25,8 +25,13 @@
 #include <R_ext/Visibility.h>
 #include "SimInf.h"
 #include "SimInf_openmp.h"
+#include "SimInf_arrow.h"
 #include "kvec.h"
 
+/* The number of identifiers in a tile when copying data from a dense
+ * matrix to a data.frame. */
+#define SIMINF_DENSE2DF_TILE 256
+
 typedef struct {
     R_xlen_t id;
     R_xlen_t time;
@@ -114,27 +119,21 @@ SimInf_insert_id_time2(
 
 static void
 SimInf_sparse2df_int(
-    SEXP dst,
+    int **p_col,
     rowinfo_vec *ri,
     SEXP m,
     int * m_i,
     R_xlen_t m_i_len,
     R_xlen_t m_stride,
-    R_xlen_t nrow,
     R_xlen_t tlen,
-    R_xlen_t n_id,
-    R_xlen_t col)
+    R_xlen_t n_id)
 {
     int *m_ir = INTEGER(GET_SLOT(m, Rf_install("i")));
     int *m_jc = INTEGER(GET_SLOT(m, Rf_install("p")));
     double *m_x = REAL(GET_SLOT(m, Rf_install("x")));
 
     for (R_xlen_t i = 0; i < m_i_len; i++) {
-        SEXP vec;
-        int *p_vec;
-
-        SET_VECTOR_ELT(dst, col++, vec = Rf_allocVector(INTSXP, nrow));
-        p_vec = INTEGER(vec);
+        int *p_vec = p_col[i];
 
         if (ri) {
             size_t k = 0;
@@ -197,27 +196,21 @@ SimInf_sparse2df_int(
 
 static void
 SimInf_sparse2df_real(
-    SEXP dst,
+    double **p_col,
     rowinfo_vec *ri,
     SEXP m,
     int * m_i,
     R_xlen_t m_i_len,
     R_xlen_t m_stride,
-    R_xlen_t nrow,
     R_xlen_t tlen,
-    R_xlen_t n_id,
-    R_xlen_t col)
+    R_xlen_t n_id)
 {
     int *m_ir = INTEGER(GET_SLOT(m, Rf_install("i")));
     int *m_jc = INTEGER(GET_SLOT(m, Rf_install("p")));
     double *m_x = REAL(GET_SLOT(m, Rf_install("x")));
 
     for (R_xlen_t i = 0; i < m_i_len; i++) {
-        SEXP vec;
-        double *p_vec;
-
-        SET_VECTOR_ELT(dst, col++, vec = Rf_allocVector(REALSXP, nrow));
-        p_vec = REAL(vec);
+        double *p_vec = p_col[i];
 
         if (ri) {
             size_t k = 0;
@@ -278,97 +271,337 @@ SimInf_sparse2df_real(
     }
 }
 
+/**
+ * Copy the requested compartments from a dense matrix to the
+ * columns of a data.frame, or to the buffers of an Arrow array.
+ *
+ * The matrix is processed in tiles of identifiers at each time
+ * point, where every requested compartment is copied from the tile
+ * while it is in the cache, instead of one pass over the whole
+ * matrix for each compartment. The tiles are processed in parallel.
+ *
+ * @param p_vec the column to fill for each requested compartment,
+ *        each with room for tlen * id_len values.
+ * @param m the dense matrix with one row for each compartment in
+ *        each identifier, and one column for each time point.
+ * @param m_i index (1-based) to the compartments to copy.
+ * @param m_i_len the number of compartments to copy.
+ * @param m_stride the number of compartments for each identifier.
+ * @param tlen the number of time points.
+ * @param id_len the number of identifiers to copy.
+ * @param id_n the number of identifiers in the matrix.
+ * @param p_id NULL or an integer vector with (1-based) indices of
+ *        the identifiers to copy.
+ * @param compartment_major if non-zero, the rows of the matrix are
+ *        ordered compartment-major, i.e., row c * id_n + id instead
+ *        of id * m_stride + c, and every compartment is copied from
+ *        a contiguous block of the column.
+ */
 static void
 SimInf_dense2df_int(
-    SEXP dst,
+    int **p_vec,
     int *m,
     int * m_i,
     R_xlen_t m_i_len,
     R_xlen_t m_stride,
-    R_xlen_t nrow,
     R_xlen_t tlen,
     R_xlen_t id_len,
     R_xlen_t id_n,
-    R_xlen_t col,
-    int *p_id)
+    int *p_id,
+    int compartment_major)
 {
-    for (R_xlen_t i = 0; i < m_i_len; i++) {
-        SEXP vec;
-        int *p_vec;
-        int *p_m = m + m_i[i] - 1;
+    const R_xlen_t n_tile =
+        (id_len + SIMINF_DENSE2DF_TILE - 1) / SIMINF_DENSE2DF_TILE;
+    const R_xlen_t id_step = compartment_major ? 1 : m_stride;
+    const R_xlen_t c_step = compartment_major ? id_n : 1;
 
-        SET_VECTOR_ELT(dst, col++, vec = Rf_allocVector(INTSXP, nrow));
-        p_vec = INTEGER(vec);
+    if (m_i_len < 1)
+        return;
 
-        if (p_id != NULL) {
-            /* Note that the identifiers are one-based. */
-            #ifdef _OPENMP
-            #  pragma omp parallel for num_threads(SimInf_num_threads())
-            #endif
-            for (R_xlen_t t = 0; t < tlen; t++) {
-                for (R_xlen_t i = 0; i < id_len; i++) {
-                    p_vec[t * id_len + i] =
-                        p_m[(t * id_n + p_id[i] - 1) * m_stride];
-                }
-            }
-        } else {
-            #ifdef _OPENMP
-            #  pragma omp parallel for num_threads(SimInf_num_threads())
-            #endif
-            for (R_xlen_t t = 0; t < tlen; t++) {
-                for (R_xlen_t i = 0; i < id_len; i++) {
-                    p_vec[t * id_len + i] =
-                        p_m[(t * id_n + i) * m_stride];
-                }
+    #ifdef _OPENMP
+    #  pragma omp parallel for num_threads(SimInf_num_threads())
+    #endif
+    for (R_xlen_t k = 0; k < tlen * n_tile; k++) {
+        const R_xlen_t t = k / n_tile;
+        const R_xlen_t begin = (k % n_tile) * SIMINF_DENSE2DF_TILE;
+        const R_xlen_t end = begin + SIMINF_DENSE2DF_TILE < id_len ?
+            begin + SIMINF_DENSE2DF_TILE : id_len;
+        const int *p_m = &m[t * id_n * m_stride];
+
+        for (R_xlen_t j = 0; j < m_i_len; j++) {
+            int *p_col = &p_vec[j][t * id_len];
+            const int *p_mj = p_m + (m_i[j] - 1) * c_step;
+
+            if (p_id != NULL) {
+                /* Note that the identifiers are one-based. */
+                for (R_xlen_t i = begin; i < end; i++)
+                    p_col[i] = p_mj[(p_id[i] - 1) * id_step];
+            } else if (compartment_major) {
+                memcpy(&p_col[begin], &p_mj[begin],
+                       (end - begin) * sizeof(int));
+            } else {
+                for (R_xlen_t i = begin; i < end; i++)
+                    p_col[i] = p_mj[i * m_stride];
             }
         }
     }
 }
 
+/**
+ * Copy the requested continuous states from a dense matrix to the
+ * columns of a data.frame, see SimInf_dense2df_int.
+ */
 static void
 SimInf_dense2df_real(
-    SEXP dst,
+    double **p_vec,
     double *m,
     int * m_i,
     R_xlen_t m_i_len,
     R_xlen_t m_stride,
-    R_xlen_t nrow,
     R_xlen_t tlen,
     R_xlen_t id_len,
     R_xlen_t id_n,
-    R_xlen_t col,
-    int *p_id)
+    int *p_id,
+    int compartment_major)
 {
-    for (R_xlen_t i = 0; i < m_i_len; i++) {
-        SEXP vec;
-        double *p_vec;
-        double *p_m = m + m_i[i] - 1;
+    const R_xlen_t n_tile =
+        (id_len + SIMINF_DENSE2DF_TILE - 1) / SIMINF_DENSE2DF_TILE;
+    const R_xlen_t id_step = compartment_major ? 1 : m_stride;
+    const R_xlen_t c_step = compartment_major ? id_n : 1;
 
-        SET_VECTOR_ELT(dst, col++, vec = Rf_allocVector(REALSXP, nrow));
-        p_vec = REAL(vec);
+    if (m_i_len < 1)
+        return;
 
-        if (p_id != NULL) {
-            /* Note that the node identifiers are one-based. */
-            #ifdef _OPENMP
-            #  pragma omp parallel for num_threads(SimInf_num_threads())
-            #endif
-            for (R_xlen_t t = 0; t < tlen; t++) {
-                for (R_xlen_t i = 0; i < id_len; i++) {
-                    p_vec[t * id_len + i] =
-                        p_m[(t * id_n + p_id[i] - 1) * m_stride];
-                }
+    #ifdef _OPENMP
+    #  pragma omp parallel for num_threads(SimInf_num_threads())
+    #endif
+    for (R_xlen_t k = 0; k < tlen * n_tile; k++) {
+        const R_xlen_t t = k / n_tile;
+        const R_xlen_t begin = (k % n_tile) * SIMINF_DENSE2DF_TILE;
+        const R_xlen_t end = begin + SIMINF_DENSE2DF_TILE < id_len ?
+            begin + SIMINF_DENSE2DF_TILE : id_len;
+        const double *p_m = &m[t * id_n * m_stride];
+
+        for (R_xlen_t j = 0; j < m_i_len; j++) {
+            double *p_col = &p_vec[j][t * id_len];
+            const double *p_mj = p_m + (m_i[j] - 1) * c_step;
+
+            if (p_id != NULL) {
+                /* Note that the identifiers are one-based. */
+                for (R_xlen_t i = begin; i < end; i++)
+                    p_col[i] = p_mj[(p_id[i] - 1) * id_step];
+            } else if (compartment_major) {
+                memcpy(&p_col[begin], &p_mj[begin],
+                       (end - begin) * sizeof(double));
+            } else {
+                for (R_xlen_t i = begin; i < end; i++)
+                    p_col[i] = p_mj[i * m_stride];
             }
+        }
+    }
+}
+
+/**
+ * Data to extract a table with one row per identifier and time point
+ * from the discrete and continuous state matrices.
+ */
+typedef struct SimInf_trajectory_data {
+    SEXP dm;             /**< The discrete state matrix. */
+    int *dm_i;           /**< Index (1-based) to the compartments in
+                          *   'dm' to include. */
+    R_xlen_t dm_i_len;   /**< The number of compartments in 'dm' to
+                          *   include. */
+    R_xlen_t dm_stride;  /**< The number of compartments in 'dm' for
+                          *   each identifier. */
+    int dm_sparse;       /**< 1 if 'dm' is a sparse matrix. */
+    SEXP cm;             /**< The continuous state matrix. */
+    int *cm_i;           /**< Index (1-based) to the states in 'cm'
+                          *   to include. */
+    R_xlen_t cm_i_len;   /**< The number of states in 'cm' to
+                          *   include. */
+    R_xlen_t cm_stride;  /**< The number of states in 'cm' for each
+                          *   identifier. */
+    int cm_sparse;       /**< 1 if 'cm' is a sparse matrix. */
+    R_xlen_t tlen;       /**< The number of time points. */
+    R_xlen_t id_n;       /**< The number of identifiers. */
+    int *p_id;           /**< NULL or (1-based) indices of the
+                          *   identifiers to include. */
+    R_xlen_t id_len;     /**< The number of identifiers to include. */
+    R_xlen_t nrow;       /**< The number of rows in the table. */
+    R_xlen_t ncol;       /**< The number of columns in the table. */
+    int compartment_major; /**< 1 if a dense 'dm' and 'cm' are
+                            *   ordered compartment-major. */
+    rowinfo_vec *ri;     /**< The identifier and time of each row if
+                          *   the table is created from sparse
+                          *   matrices, else NULL. */
+} SimInf_trajectory_data;
+
+/**
+ * Initialize the data to extract a table from a simulated
+ * trajectory, see 'SimInf_trajectory' for a description of the
+ * arguments.
+ *
+ * @return 0 if Ok, else error code.
+ */
+static int
+SimInf_trajectory_init(
+    SimInf_trajectory_data *d,
+    SEXP dm,
+    SEXP dm_i,
+    SEXP dm_lbl,
+    SEXP cm,
+    SEXP cm_i,
+    SEXP cm_lbl,
+    SEXP tspan,
+    SEXP id_n,
+    SEXP id,
+    SEXP layout)
+{
+    d->dm = dm;
+    d->dm_i = INTEGER(dm_i);
+    d->dm_i_len = XLENGTH(dm_i);
+    d->dm_stride = Rf_isNull(dm_lbl) ? 0 : XLENGTH(dm_lbl);
+    d->dm_sparse = Rf_isS4(dm) && Rf_inherits(dm, "dgCMatrix") ? 1 : 0;
+    d->cm = cm;
+    d->cm_i = INTEGER(cm_i);
+    d->cm_i_len = XLENGTH(cm_i);
+    d->cm_stride = Rf_isNull(cm_lbl) ? 0 : XLENGTH(cm_lbl);
+    d->cm_sparse = Rf_isS4(cm) && Rf_inherits(cm, "dgCMatrix") ? 1 : 0;
+    d->tlen = XLENGTH(tspan);
+    d->id_n = Rf_asInteger(id_n);
+    d->p_id = Rf_isNull(id) ? NULL : INTEGER(id);
+    d->id_len = Rf_isNull(id) ? d->id_n : XLENGTH(id);
+    d->nrow = d->tlen * d->id_len;
+    d->ncol = 2 + d->dm_i_len + d->cm_i_len; /* The '2' is for the
+                                              * 'identifier' and
+                                              * 'time' columns. */
+    d->compartment_major = Rf_asLogical(layout) == TRUE;
+    d->ri = NULL;
+
+    /* Determine the number of rows that is required for the
+     * data.frame. If either U or V is a dense matrix, then we need a
+     * full data.frame with one row per node and time point, else the
+     * number of rows depends on unique combinations of identifier and
+     * time information in the sparse matrices. */
+    if ((d->dm_i_len > 0 && d->cm_i_len > 0 && d->dm_sparse && d->cm_sparse) ||
+        (d->dm_i_len > 0 && d->cm_i_len == 0 && d->dm_sparse) ||
+        (d->dm_i_len == 0 && d->cm_i_len > 0 && d->cm_sparse)) {
+        d->ri = calloc(1, sizeof(rowinfo_vec));
+        if (!d->ri)
+            return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+        if (d->dm_i_len > 0 && d->cm_i_len > 0) {
+            SimInf_insert_id_time2(d->ri, dm, cm, d->dm_stride,
+                                   d->cm_stride, d->tlen);
+        } else if (d->dm_i_len > 0) {
+            SimInf_insert_id_time(d->ri, dm, d->dm_stride, d->tlen);
         } else {
-            #ifdef _OPENMP
-            #  pragma omp parallel for num_threads(SimInf_num_threads())
-            #endif
-            for (R_xlen_t t = 0; t < tlen; t++) {
-                for (R_xlen_t i = 0; i < id_len; i++) {
-                    p_vec[t * id_len + i] =
-                        p_m[(t * id_n + i) * m_stride];
-                }
-            }
+            SimInf_insert_id_time(d->ri, cm, d->cm_stride, d->tlen);
         }
+
+        d->nrow = kv_size(*d->ri);
+    }
+
+    return 0;
+}
+
+static void
+SimInf_trajectory_free(
+    SimInf_trajectory_data *d)
+{
+    if (d->ri) {
+        kv_destroy(*d->ri);
+        free(d->ri);
+        d->ri = NULL;
+    }
+}
+
+/**
+ * Fill the (1-based) identifier of each row.
+ */
+static void
+SimInf_trajectory_id(
+    const SimInf_trajectory_data *d,
+    int *p_vec)
+{
+    if (d->ri) {
+        for (size_t i = 0; i < kv_size(*d->ri); i++)
+            p_vec[i] = kv_A(*d->ri, i).id + 1;
+    } else if (d->p_id != NULL) {
+        #ifdef _OPENMP
+        #  pragma omp parallel for num_threads(SimInf_num_threads())
+        #endif
+        for (R_xlen_t t = 0; t < d->tlen; t++) {
+            memcpy(&p_vec[t * d->id_len], d->p_id, d->id_len * sizeof(int));
+        }
+    } else {
+        #ifdef _OPENMP
+        #  pragma omp parallel for num_threads(SimInf_num_threads())
+        #endif
+        for (R_xlen_t t = 0; t < d->tlen; t++) {
+            for (R_xlen_t i = 0; i < d->id_len; i++)
+                p_vec[t * d->id_len + i] = i + 1;
+        }
+    }
+}
+
+/**
+ * Fill the time of each row, or the (0-based) index to the time
+ * point in 'tspan' if 'p_tspan' is NULL.
+ */
+static void
+SimInf_trajectory_time(
+    const SimInf_trajectory_data *d,
+    const double *p_tspan,
+    int *p_vec)
+{
+    if (d->ri) {
+        for (size_t i = 0; i < kv_size(*d->ri); i++) {
+            R_xlen_t t = kv_A(*d->ri, i).time;
+            p_vec[i] = p_tspan ? p_tspan[t] : t;
+        }
+    } else {
+        #ifdef _OPENMP
+        #  pragma omp parallel for num_threads(SimInf_num_threads())
+        #endif
+        for (R_xlen_t t = 0; t < d->tlen; t++) {
+            for (R_xlen_t i = 0; i < d->id_len; i++)
+                p_vec[t * d->id_len + i] = p_tspan ? p_tspan[t] : t;
+        }
+    }
+}
+
+/**
+ * Copy the requested discrete and continuous states to the columns.
+ *
+ * @param d the data to extract.
+ * @param dm_col the column for each requested compartment.
+ * @param cm_col the column for each requested continuous state.
+ */
+static void
+SimInf_trajectory_copy(
+    const SimInf_trajectory_data *d,
+    int **dm_col,
+    double **cm_col)
+{
+    /* Copy data from the discrete state matrix. */
+    if (d->dm_sparse) {
+        SimInf_sparse2df_int(dm_col, d->ri, d->dm, d->dm_i, d->dm_i_len,
+                             d->dm_stride, d->tlen, d->id_len);
+    } else {
+        SimInf_dense2df_int(dm_col, INTEGER(d->dm), d->dm_i, d->dm_i_len,
+                            d->dm_stride, d->tlen, d->id_len, d->id_n,
+                            d->p_id, d->compartment_major);
+    }
+
+    /* Copy data from the continuous state matrix. */
+    if (d->cm_sparse) {
+        SimInf_sparse2df_real(cm_col, d->ri, d->cm, d->cm_i, d->cm_i_len,
+                              d->cm_stride, d->tlen, d->id_len);
+    } else {
+        SimInf_dense2df_real(cm_col, REAL(d->cm), d->cm_i, d->cm_i_len,
+                             d->cm_stride, d->tlen, d->id_len, d->id_n,
+                             d->p_id, d->compartment_major);
     }
 }
 
@@ -392,6 +625,10 @@ SimInf_dense2df_real(
  *        identifiers to include in the data.frame.
  * @param id_lbl character vector of length one with the name of the
  *        identifier column.
+ * @param layout logical vector of length one that is TRUE if a dense
+ *        'dm' and 'cm' are ordered compartment-major, i.e., row
+ *        c * id_n + id instead of id * Nc + c. A sparse 'dm' or
+ *        'cm' is always ordered by identifier.
  * @return A data.frame.
  */
 SEXP attribute_hidden
@@ -405,181 +642,278 @@ SimInf_trajectory(
     SEXP tspan,
     SEXP id_n,
     SEXP id,
-    SEXP id_lbl)
+    SEXP id_lbl,
+    SEXP layout)
 {
-    SEXP colnames, result, vec;
+    SEXP colnames, result = R_NilValue, vec;
+    SimInf_trajectory_data d;
     int error = 0;
     int nprotect = 0;
     int *p_vec;
-    int *p_id = Rf_isNull(id) ? NULL : INTEGER(id);
-    R_xlen_t dm_i_len = XLENGTH(dm_i);
-    R_xlen_t dm_stride = Rf_isNull(dm_lbl) ? 0 : XLENGTH(dm_lbl);
-    int dm_sparse = Rf_isS4(dm) && Rf_inherits(dm, "dgCMatrix") ? 1 : 0;
-    R_xlen_t cm_i_len = XLENGTH(cm_i);
-    R_xlen_t cm_stride = Rf_isNull(cm_lbl) ? 0 : XLENGTH(cm_lbl);
-    int cm_sparse = Rf_isS4(cm) && Rf_inherits(cm, "dgCMatrix") ? 1 : 0;
-    R_xlen_t tlen = XLENGTH(tspan);
-    R_xlen_t c_id_n = Rf_asInteger(id_n);
-    R_xlen_t id_len = Rf_isNull(id) ? c_id_n : XLENGTH(id);
-    R_xlen_t nrow = tlen * id_len;
-    R_xlen_t ncol = 2 + dm_i_len + cm_i_len; /* The '2' is for the
-                                              * 'identifier' and
-                                              * 'time' columns. */
-    rowinfo_vec *ri = NULL;
+    int **dm_col;
+    double **cm_col;
 
     /* Use all available threads in parallel regions. */
     SimInf_set_num_threads(-1);
 
+    error = SimInf_trajectory_init(&d, dm, dm_i, dm_lbl, cm, cm_i, cm_lbl,
+                                   tspan, id_n, id, layout);
+    if (error)
+        goto cleanup; /* #nocov */
+
     /* Create a vector for the column names. */
-    PROTECT(colnames = Rf_allocVector(STRSXP, ncol));
+    PROTECT(colnames = Rf_allocVector(STRSXP, d.ncol));
     nprotect++;
     SET_STRING_ELT(colnames, 0, STRING_ELT(id_lbl, 0));
     SET_STRING_ELT(colnames, 1, Rf_mkChar("time"));
-    for (R_xlen_t i = 0; i < dm_i_len; i++) {
-        R_xlen_t j = INTEGER(dm_i)[i] - 1;
+    for (R_xlen_t i = 0; i < d.dm_i_len; i++) {
+        R_xlen_t j = d.dm_i[i] - 1;
         SET_STRING_ELT(colnames, 2 + i, STRING_ELT(dm_lbl, j));
     }
-    for (R_xlen_t i = 0; i < cm_i_len; i++) {
-        R_xlen_t j = INTEGER(cm_i)[i] - 1;
-        SET_STRING_ELT(colnames, 2 + dm_i_len + i, STRING_ELT(cm_lbl, j));
-    }
-
-    /* Determine the number of rows that is required for the
-     * data.frame. If either U or V is a dense matrix, then we need a
-     * full data.frame with one row per node and time point, else the
-     * number of rows depends on unique combinations of identifier and
-     * time information in the sparse matrices. */
-    if (dm_i_len > 0 && cm_i_len > 0) {
-        if (dm_sparse && cm_sparse) {
-            ri = calloc(1, sizeof(rowinfo_vec));
-            if (!ri) {
-                error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
-                goto cleanup;                           /* #nocov */
-            }
-            SimInf_insert_id_time2(ri, dm, cm, dm_stride, cm_stride, tlen);
-            nrow = kv_size(*ri);
-        }
-    } else if (dm_i_len > 0 && dm_sparse) {
-        ri = calloc(1, sizeof(rowinfo_vec));
-        if (!ri) {
-            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
-            goto cleanup;                           /* #nocov */
-        }
-        SimInf_insert_id_time(ri, dm, dm_stride, tlen);
-        nrow = kv_size(*ri);
-    } else if (cm_i_len > 0 && cm_sparse) {
-        ri = calloc(1, sizeof(rowinfo_vec));
-        if (!ri) {
-            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
-            goto cleanup;                           /* #nocov */
-        }
-        SimInf_insert_id_time(ri, cm, cm_stride, tlen);
-        nrow = kv_size(*ri);
+    for (R_xlen_t i = 0; i < d.cm_i_len; i++) {
+        R_xlen_t j = d.cm_i[i] - 1;
+        SET_STRING_ELT(colnames, 2 + d.dm_i_len + i, STRING_ELT(cm_lbl, j));
     }
 
     /* Create a list for the 'data.frame' and add colnames and a
      * 'data.frame' class attribute. */
-    PROTECT(result = Rf_allocVector(VECSXP, ncol));
+    PROTECT(result = Rf_allocVector(VECSXP, d.ncol));
     nprotect++;
     Rf_setAttrib(result, R_NamesSymbol, colnames);
     Rf_setAttrib(result, R_ClassSymbol, Rf_mkString("data.frame"));
 
     /* Add row names to the 'data.frame'. Note that the row names are
      * one-based. */
-    PROTECT(vec = Rf_allocVector(INTSXP, nrow));
+    PROTECT(vec = Rf_allocVector(INTSXP, d.nrow));
     nprotect++;
     p_vec = INTEGER(vec);
     #ifdef _OPENMP
     #  pragma omp parallel for num_threads(SimInf_num_threads())
     #endif
-    for (R_xlen_t i = 0; i < nrow; i++) {
+    for (R_xlen_t i = 0; i < d.nrow; i++) {
         p_vec[i] = i + 1;
     }
     Rf_setAttrib(result, R_RowNamesSymbol, vec);
 
     /* Add an identifier column to the 'data.frame'. */
-    SET_VECTOR_ELT(result, 0, vec = Rf_allocVector(INTSXP, nrow));
-    p_vec = INTEGER(vec);
-    if (ri) {
-        for (size_t i = 0; i < kv_size(*ri); i++)
-            p_vec[i] = kv_A(*ri, i).id + 1;
-    } else if (p_id != NULL) {
-        #ifdef _OPENMP
-        #  pragma omp parallel for num_threads(SimInf_num_threads())
-        #endif
-        for (R_xlen_t t = 0; t < tlen; t++) {
-            memcpy(&p_vec[t * id_len], p_id, id_len * sizeof(int));
-        }
-    } else {
-        #ifdef _OPENMP
-        #  pragma omp parallel for num_threads(SimInf_num_threads())
-        #endif
-        for (R_xlen_t t = 0; t < tlen; t++) {
-            for (R_xlen_t i = 0; i < id_len; i++)
-                p_vec[t * id_len + i] = i + 1;
-        }
-    }
+    SET_VECTOR_ELT(result, 0, vec = Rf_allocVector(INTSXP, d.nrow));
+    SimInf_trajectory_id(&d, INTEGER(vec));
 
     /* Add a 'time' column to the 'data.frame'. */
     if (Rf_isNull(Rf_getAttrib(tspan, R_NamesSymbol))) {
-        double *p_tspan = REAL(tspan);
-
-        SET_VECTOR_ELT(result, 1, vec = Rf_allocVector(INTSXP, nrow));
-        p_vec = INTEGER(vec);
-        if (ri) {
-            for (size_t i = 0; i < kv_size(*ri); i++)
-                p_vec[i] = p_tspan[kv_A(*ri, i).time];
-        } else {
-            #ifdef _OPENMP
-            #  pragma omp parallel for num_threads(SimInf_num_threads())
-            #endif
-            for (R_xlen_t t = 0; t < tlen; t++) {
-                for (R_xlen_t i = 0; i < id_len; i++)
-                    p_vec[t * id_len + i] = p_tspan[t];
-            }
-        }
+        SET_VECTOR_ELT(result, 1, vec = Rf_allocVector(INTSXP, d.nrow));
+        SimInf_trajectory_time(&d, REAL(tspan), INTEGER(vec));
     } else {
         SEXP lbl_tspan = PROTECT(Rf_getAttrib(tspan, R_NamesSymbol));
         nprotect++;
 
-        SET_VECTOR_ELT(result, 1, vec = Rf_allocVector(STRSXP, nrow));
-        if (ri) {
-            for (size_t i = 0; i < kv_size(*ri); i++)
-                SET_STRING_ELT(vec, i, STRING_ELT(lbl_tspan, kv_A(*ri, i).time));
+        SET_VECTOR_ELT(result, 1, vec = Rf_allocVector(STRSXP, d.nrow));
+        if (d.ri) {
+            for (size_t i = 0; i < kv_size(*d.ri); i++)
+                SET_STRING_ELT(vec, i, STRING_ELT(lbl_tspan, kv_A(*d.ri, i).time));
         } else {
-            for (R_xlen_t t = 0; t < tlen; t++) {
-                for (R_xlen_t i = 0; i < id_len; i++)
-                    SET_STRING_ELT(vec, t * id_len + i, STRING_ELT(lbl_tspan, t));
+            for (R_xlen_t t = 0; t < d.tlen; t++) {
+                for (R_xlen_t i = 0; i < d.id_len; i++)
+                    SET_STRING_ELT(vec, t * d.id_len + i, STRING_ELT(lbl_tspan, t));
             }
         }
     }
 
-    /* Copy data from the discrete state matrix. */
-    if (dm_sparse) {
-        SimInf_sparse2df_int(result, ri, dm, INTEGER(dm_i), dm_i_len,
-                             dm_stride, nrow, tlen, id_len, 2);
-    } else {
-        SimInf_dense2df_int(result, INTEGER(dm), INTEGER(dm_i), dm_i_len,
-                            dm_stride, nrow, tlen, id_len, c_id_n, 2, p_id);
+    /* Allocate all columns before copying the data in parallel. */
+    dm_col = (int **)R_alloc(d.dm_i_len, sizeof(int *));
+    for (R_xlen_t i = 0; i < d.dm_i_len; i++) {
+        SET_VECTOR_ELT(result, 2 + i, vec = Rf_allocVector(INTSXP, d.nrow));
+        dm_col[i] = INTEGER(vec);
+    }
+    cm_col = (double **)R_alloc(d.cm_i_len, sizeof(double *));
+    for (R_xlen_t i = 0; i < d.cm_i_len; i++) {
+        SET_VECTOR_ELT(result, 2 + d.dm_i_len + i,
+                       vec = Rf_allocVector(REALSXP, d.nrow));
+        cm_col[i] = REAL(vec);
     }
 
-    /* Copy data from the continuous state matrix. */
-    if (cm_sparse) {
-        SimInf_sparse2df_real(result, ri, cm, INTEGER(cm_i), cm_i_len,
-                              cm_stride, nrow, tlen, id_len, 2 + dm_i_len);
+    SimInf_trajectory_copy(&d, dm_col, cm_col);
+
+cleanup:
+    SimInf_trajectory_free(&d);
+
+    if (nprotect)
+        UNPROTECT(nprotect);
+
+    if (error)
+        Rf_error("Unable to allocate memory buffer."); /* #nocov */
+
+    return result;
+}
+
+/**
+ * Export data from a simulated trajectory as a record batch through
+ * the Arrow C data interface.
+ *
+ * The table has the same rows and columns as the data.frame from
+ * 'SimInf_trajectory', but every column is written directly, in a
+ * single pass from the dense or sparse matrices, to a buffer that is
+ * owned by the exported array. A missing value in the sparse
+ * matrices is null in the array.
+ *
+ * @param dm data for the discrete state matrix to export.
+ * @param dm_i index (1-based) to compartments in 'dm' to include.
+ * @param dm_lbl state names of the data in 'dm'.
+ * @param cm data for the continuous state matrix to export.
+ * @param cm_i index (1-based) to compartments in 'cm' to include.
+ * @param cm_lbl state names of the data in 'cm'.
+ * @param tspan a vector of increasing time points for the time
+ *        in each column in 'dm' and 'cm'.
+ * @param id_n number of identifiers in the model.
+ * @param id NULL or an integer vector with (1-based) indices of the
+ *        identifiers to include.
+ * @param id_lbl character vector of length one with the name of the
+ *        identifier column.
+ * @param layout logical vector of length one that is TRUE if a dense
+ *        'dm' and 'cm' are ordered compartment-major.
+ * @return a list with the external pointers 'schema' and 'array' to
+ *         an ArrowSchema and an ArrowArray of type struct.
+ */
+SEXP attribute_hidden
+SimInf_trajectory_arrow(
+    SEXP dm,
+    SEXP dm_i,
+    SEXP dm_lbl,
+    SEXP cm,
+    SEXP cm_i,
+    SEXP cm_lbl,
+    SEXP tspan,
+    SEXP id_n,
+    SEXP id,
+    SEXP id_lbl,
+    SEXP layout)
+{
+    SEXP result = R_NilValue, lbl_tspan;
+    SimInf_trajectory_data d;
+    struct ArrowSchema *schema = NULL;
+    struct ArrowArray *array = NULL;
+    int **dm_col = NULL;
+    double **cm_col = NULL;
+    int *p_vec;
+    int error = 0;
+
+    /* The names and labels must be in UTF-8 in the exported data. */
+    PROTECT(dm_lbl = SimInf_arrow_utf8(dm_lbl));
+    PROTECT(cm_lbl = SimInf_arrow_utf8(cm_lbl));
+    PROTECT(id_lbl = SimInf_arrow_utf8(id_lbl));
+    PROTECT(lbl_tspan = SimInf_arrow_utf8(Rf_getAttrib(tspan, R_NamesSymbol)));
+
+    /* Use all available threads in parallel regions. */
+    SimInf_set_num_threads(-1);
+
+    error = SimInf_trajectory_init(&d, dm, dm_i, dm_lbl, cm, cm_i, cm_lbl,
+                                   tspan, id_n, id, layout);
+    if (error)
+        goto cleanup; /* #nocov */
+
+    schema = calloc(1, sizeof(struct ArrowSchema));
+    array = calloc(1, sizeof(struct ArrowArray));
+    dm_col = calloc(d.dm_i_len > 0 ? d.dm_i_len : 1, sizeof(int *));
+    cm_col = calloc(d.cm_i_len > 0 ? d.cm_i_len : 1, sizeof(double *));
+    if (!schema || !array || !dm_col || !cm_col) {
+        error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+        goto cleanup;                           /* #nocov */
+    }
+
+    error = SimInf_arrow_struct(schema, array, d.ncol, d.nrow);
+    if (error)
+        goto cleanup; /* #nocov */
+
+    /* Add an identifier column. */
+    p_vec = SimInf_arrow_column(schema->children[0], array->children[0],
+                                "i", CHAR(STRING_ELT(id_lbl, 0)),
+                                d.nrow, sizeof(int));
+    if (!p_vec) {
+        error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+        goto cleanup;                           /* #nocov */
+    }
+    SimInf_trajectory_id(&d, p_vec);
+
+    /* Add a 'time' column, with the labels of 'tspan' if it has
+     * names. */
+    if (Rf_isNull(lbl_tspan)) {
+        p_vec = SimInf_arrow_column(schema->children[1], array->children[1],
+                                    "i", "time", d.nrow, sizeof(int));
+        if (!p_vec) {
+            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+            goto cleanup;                           /* #nocov */
+        }
+        SimInf_trajectory_time(&d, REAL(tspan), p_vec);
     } else {
-        SimInf_dense2df_real(result, REAL(cm), INTEGER(cm_i), cm_i_len, cm_stride,
-                             nrow, tlen, id_len, c_id_n, 2 + dm_i_len, p_id);
+        int *time = malloc(d.nrow > 0 ? d.nrow * sizeof(int) : 1);
+
+        if (!time) {
+            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+            goto cleanup;                           /* #nocov */
+        }
+        SimInf_trajectory_time(&d, NULL, time);
+        error = SimInf_arrow_string_column(
+            schema->children[1], array->children[1], "time",
+            lbl_tspan, time, d.nrow);
+        free(time);
+        if (error)
+            goto cleanup; /* #nocov */
     }
 
+    /* Allocate all columns before copying the data in parallel. */
+    for (R_xlen_t i = 0; i < d.dm_i_len; i++) {
+        dm_col[i] = SimInf_arrow_column(
+            schema->children[2 + i], array->children[2 + i], "i",
+            CHAR(STRING_ELT(dm_lbl, d.dm_i[i] - 1)), d.nrow, sizeof(int));
+        if (!dm_col[i]) {
+            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+            goto cleanup;                           /* #nocov */
+        }
+    }
+    for (R_xlen_t i = 0; i < d.cm_i_len; i++) {
+        R_xlen_t j = 2 + d.dm_i_len + i;
+
+        cm_col[i] = SimInf_arrow_column(
+            schema->children[j], array->children[j], "g",
+            CHAR(STRING_ELT(cm_lbl, d.cm_i[i] - 1)), d.nrow, sizeof(double));
+        if (!cm_col[i]) {
+            error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+            goto cleanup;                           /* #nocov */
+        }
+    }
+
+    SimInf_trajectory_copy(&d, dm_col, cm_col);
+
+    /* Only the sparse matrices can give missing values. */
+    for (R_xlen_t i = 0; d.dm_sparse && !error && i < d.dm_i_len; i++)
+        error = SimInf_arrow_column_nulls(array->children[2 + i], 1);
+    for (R_xlen_t i = 0; d.cm_sparse && !error && i < d.cm_i_len; i++)
+        error = SimInf_arrow_column_nulls(array->children[2 + d.dm_i_len + i], 0);
+    if (error)
+        goto cleanup; /* #nocov */
+
+    result = SimInf_arrow_xptr(schema, array);
+    schema = NULL;
+    array = NULL;
+
 cleanup:
-    if (ri) {
-        kv_destroy(*ri);
-        free(ri);
+    SimInf_trajectory_free(&d);
+    free(dm_col);
+    free(cm_col);
+
+    if (schema) {
+        if (schema->release)
+            schema->release(schema);
+        free(schema);
     }
 
-    if (nprotect)
-        UNPROTECT(nprotect);
+    if (array) {
+        if (array->release)
+            array->release(array);
+        free(array);
+    }
+
+    UNPROTECT(4);
 
     if (error)
         Rf_error("Unable to allocate memory buffer."); /* #nocov */
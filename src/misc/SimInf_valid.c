@@ -0,0 +1,353 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 Pavol Bauer
+ * Copyright (C) 2017 -- 2019 Robin Eriksson
+ * Copyright (C) 2015 -- 2019 Stefan Engblom
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <Rdefines.h>
+#include <R_ext/Visibility.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "SimInf.h"
+#include "SimInf_openmp.h"
+
+/* The maximum number of row indices to include in a message. */
+#define SIMINF_VALID_MAX_ROWS 5
+
+/* The checks of the scheduled events, in the order they are
+ * reported. */
+enum {
+    VALID_EVENTS_TIME,
+    VALID_EVENTS_EVENT,
+    VALID_EVENTS_NODE,
+    VALID_EVENTS_DEST,
+    VALID_EVENTS_PROPORTION,
+    VALID_EVENTS_SELECT,
+    VALID_EVENTS_SHIFT,
+    VALID_EVENTS_SHIFT_N,
+    VALID_EVENTS_PERIOD,
+    VALID_EVENTS_END,
+    VALID_EVENTS_N_CHECKS
+};
+
+static const char *SimInf_valid_events_msg[VALID_EVENTS_N_CHECKS] = {
+    "time must be greater than 0",
+    "event must be in the range 0 <= event <= 3",
+    "'node' must be greater or equal to 1",
+    "'dest' must be greater or equal to 1",
+    "prop must be in the range 0 <= prop <= 1",
+    "select must be in the range 1 <= select <= Nselect",
+    "'shift' must be greater or equal to 1",
+    "'shift' must be in the range 1 <= shift <= Nshift",
+    "'period' must be greater or equal to 0",
+    "'end' must be greater or equal to 'time' for a recurring event"
+};
+
+/* The result of one check: the total number of failing rows and the
+ * (zero-based) index of the first failing rows. */
+typedef struct SimInf_valid_check
+{
+    R_xlen_t count;
+    R_xlen_t rows[SIMINF_VALID_MAX_ROWS];
+} SimInf_valid_check;
+
+static void SimInf_valid_check_add(SimInf_valid_check *check, R_xlen_t row)
+{
+    if (check->count < SIMINF_VALID_MAX_ROWS)
+        check->rows[check->count] = row;
+    check->count++;
+}
+
+/**
+ * Merge the result of a check from a chunk of rows into the result
+ * of the preceding chunks.
+ *
+ * @param dst The result of the preceding chunks.
+ * @param src The result of the chunk to merge.
+ */
+static void SimInf_valid_check_merge(
+    SimInf_valid_check *dst,
+    const SimInf_valid_check *src)
+{
+    R_xlen_t i;
+
+    for (i = 0; i < src->count && i < SIMINF_VALID_MAX_ROWS; i++) {
+        if (dst->count + i < SIMINF_VALID_MAX_ROWS)
+            dst->rows[dst->count + i] = src->rows[i];
+    }
+
+    dst->count += src->count;
+}
+
+/**
+ * Format a message with the one-based index of the failing rows.
+ *
+ * @param msg The message of the check.
+ * @param label The label of the index, for example, 'row'.
+ * @param check The result of the check.
+ * @return a CHARSXP with the message.
+ */
+static SEXP SimInf_valid_check_message(
+    const char *msg,
+    const char *label,
+    const SimInf_valid_check *check)
+{
+    char buf[512];
+    int i, len;
+
+    len = snprintf(buf, sizeof(buf), "%s (%s%s ", msg, label,
+                   check->count > 1 ? "s" : "");
+
+    for (i = 0; i < check->count && i < SIMINF_VALID_MAX_ROWS; i++) {
+        len += snprintf(buf + len, sizeof(buf) - len, "%s%.0f",
+                        i > 0 ? ", " : "", (double)check->rows[i] + 1);
+    }
+
+    if (check->count > SIMINF_VALID_MAX_ROWS) {
+        snprintf(buf + len, sizeof(buf) - len, ", ...; %.0f in total).",
+                 (double)check->count);
+    } else {
+        snprintf(buf + len, sizeof(buf) - len, ").");
+    }
+
+    return Rf_mkChar(buf);
+}
+
+/**
+ * Check the scheduled events in a 'SimInf_events' object.
+ *
+ * All the rows are checked in one parallel pass over the event
+ * vectors, where each thread checks a contiguous chunk of rows. The
+ * result from each chunk is then merged in order so that the
+ * reported row indices are the first failing rows in each check.
+ *
+ * @param events The 'SimInf_events' object to check.
+ * @return a character vector with one message for each failing check,
+ *         or an empty character vector if the events are valid.
+ */
+SEXP attribute_hidden SimInf_valid_events(SEXP events)
+{
+    SEXP E, N, result;
+    SimInf_valid_check *checks = NULL;
+    SimInf_valid_check total[VALID_EVENTS_N_CHECKS] = {{0}};
+    const int *event, *time, *node, *dest, *select, *shift;
+    const int *period = NULL, *period_end = NULL;
+    const double *proportion, *prE;
+    R_xlen_t i, len, len_prE;
+    int Nselect, Nshift, Nthread, n_errors = 0, n_protect = 0;
+    int negative_E = 0;
+
+    /* Check that the select matrix 'E' has no negative elements. */
+    PROTECT(E = GET_SLOT(events, Rf_install("E")));
+    n_protect++;
+    prE = REAL(GET_SLOT(E, Rf_install("x")));
+    len_prE = XLENGTH(GET_SLOT(E, Rf_install("x")));
+    for (i = 0; i < len_prE && !negative_E; i++) {
+        if (prE[i] < 0)
+            negative_E = 1;
+    }
+
+    if (negative_E) {
+        PROTECT(result = Rf_mkString("Select matrix 'E' has negative elements."));
+        n_protect++;
+        goto cleanup;
+    }
+
+    len = XLENGTH(GET_SLOT(events, Rf_install("event")));
+    if (XLENGTH(GET_SLOT(events, Rf_install("time"))) != len ||
+        XLENGTH(GET_SLOT(events, Rf_install("node"))) != len ||
+        XLENGTH(GET_SLOT(events, Rf_install("dest"))) != len ||
+        XLENGTH(GET_SLOT(events, Rf_install("n"))) != len ||
+        XLENGTH(GET_SLOT(events, Rf_install("proportion"))) != len ||
+        XLENGTH(GET_SLOT(events, Rf_install("select"))) != len ||
+        XLENGTH(GET_SLOT(events, Rf_install("shift"))) != len ||
+        (XLENGTH(GET_SLOT(events, Rf_install("period"))) != 0 &&
+         XLENGTH(GET_SLOT(events, Rf_install("period"))) != len) ||
+        XLENGTH(GET_SLOT(events, Rf_install("end"))) !=
+        XLENGTH(GET_SLOT(events, Rf_install("period"))))
+    {
+        PROTECT(result = Rf_mkString("All scheduled events must have equal length."));
+        n_protect++;
+        goto cleanup;
+    }
+
+    event = INTEGER(GET_SLOT(events, Rf_install("event")));
+    time = INTEGER(GET_SLOT(events, Rf_install("time")));
+    node = INTEGER(GET_SLOT(events, Rf_install("node")));
+    dest = INTEGER(GET_SLOT(events, Rf_install("dest")));
+    proportion = REAL(GET_SLOT(events, Rf_install("proportion")));
+    select = INTEGER(GET_SLOT(events, Rf_install("select")));
+    shift = INTEGER(GET_SLOT(events, Rf_install("shift")));
+    if (XLENGTH(GET_SLOT(events, Rf_install("period")))) {
+        period = INTEGER(GET_SLOT(events, Rf_install("period")));
+        period_end = INTEGER(GET_SLOT(events, Rf_install("end")));
+    }
+    Nselect = INTEGER(GET_SLOT(E, Rf_install("Dim")))[1];
+
+    /* The upper bound of 'shift' can only be checked when the shift
+     * matrix 'N' is defined. */
+    PROTECT(N = GET_SLOT(events, Rf_install("N")));
+    n_protect++;
+    Nshift = Rf_nrows(N) > 0 ? Rf_ncols(N) : 0;
+
+    /* Use one chunk of rows for each thread, but make sure to not use
+     * more threads than rows. */
+    Nthread = SimInf_set_num_threads(len < INT_MAX ? (int)len : INT_MAX);
+    if (Nthread < 1)
+        Nthread = 1;
+    checks = calloc(Nthread * VALID_EVENTS_N_CHECKS, sizeof(SimInf_valid_check));
+    if (!checks)
+        Rf_error("Unable to allocate memory buffer."); /* #nocov */
+
+    #ifdef _OPENMP
+    #  pragma omp parallel for num_threads(Nthread)
+    #endif
+    for (int k = 0; k < Nthread; k++) {
+        SimInf_valid_check *c = &checks[k * VALID_EVENTS_N_CHECKS];
+        const R_xlen_t chunk = len / Nthread + (len % Nthread ? 1 : 0);
+        const R_xlen_t end = (k + 1) * chunk < len ? (k + 1) * chunk : len;
+
+        for (R_xlen_t j = k * chunk; j < end; j++) {
+            if (time[j] == NA_INTEGER || time[j] <= 0)
+                SimInf_valid_check_add(&c[VALID_EVENTS_TIME], j);
+
+            if (event[j] == NA_INTEGER || event[j] < 0 || event[j] > 3)
+                SimInf_valid_check_add(&c[VALID_EVENTS_EVENT], j);
+
+            if (node[j] == NA_INTEGER || node[j] < (event[j] == 2 ? 0 : 1))
+                SimInf_valid_check_add(&c[VALID_EVENTS_NODE], j);
+
+            if (event[j] == 3 && (dest[j] == NA_INTEGER || dest[j] < 1))
+                SimInf_valid_check_add(&c[VALID_EVENTS_DEST], j);
+
+            if (!(proportion[j] >= 0.0 && proportion[j] <= 1.0))
+                SimInf_valid_check_add(&c[VALID_EVENTS_PROPORTION], j);
+
+            if (select[j] == NA_INTEGER || select[j] < 1 || select[j] > Nselect)
+                SimInf_valid_check_add(&c[VALID_EVENTS_SELECT], j);
+
+            if (event[j] == 2 && (shift[j] == NA_INTEGER || shift[j] < 1)) {
+                SimInf_valid_check_add(&c[VALID_EVENTS_SHIFT], j);
+            } else if (Nshift > 0 && event[j] > 0 && event[j] <= 3 &&
+                       shift[j] > Nshift) {
+                /* The enter, internal transfer and external transfer
+                 * events use column 'shift' in 'N'. */
+                SimInf_valid_check_add(&c[VALID_EVENTS_SHIFT_N], j);
+            }
+
+            if (period) {
+                if (period[j] == NA_INTEGER || period[j] < 0) {
+                    SimInf_valid_check_add(&c[VALID_EVENTS_PERIOD], j);
+                } else if (period[j] > 0 &&
+                           (period_end[j] == NA_INTEGER ||
+                            period_end[j] < time[j])) {
+                    SimInf_valid_check_add(&c[VALID_EVENTS_END], j);
+                }
+            }
+        }
+    }
+
+    /* Merge the result from each chunk in order. */
+    for (int k = 0; k < Nthread; k++) {
+        for (int j = 0; j < VALID_EVENTS_N_CHECKS; j++) {
+            SimInf_valid_check_merge(
+                &total[j], &checks[k * VALID_EVENTS_N_CHECKS + j]);
+        }
+    }
+
+    for (int j = 0; j < VALID_EVENTS_N_CHECKS; j++) {
+        if (total[j].count > 0)
+            n_errors++;
+    }
+
+    PROTECT(result = Rf_allocVector(STRSXP, n_errors));
+    n_protect++;
+    for (int j = 0, k = 0; j < VALID_EVENTS_N_CHECKS; j++) {
+        if (total[j].count > 0) {
+            SET_STRING_ELT(result, k++, SimInf_valid_check_message(
+                               SimInf_valid_events_msg[j], "row", &total[j]));
+        }
+    }
+
+cleanup:
+    free(checks);
+    UNPROTECT(n_protect);
+    return result;
+}
+
+/**
+ * Check that an initial state matrix has no negative elements.
+ *
+ * @param x The integer matrix to check, for example, 'u0'.
+ * @param msg The message to report if there are negative elements.
+ * @return a character vector with the message and the index to the
+ *         first nodes (columns) with negative elements, or an empty
+ *         character vector if all elements are non-negative.
+ */
+SEXP attribute_hidden SimInf_valid_state(SEXP x, SEXP msg)
+{
+    SEXP result;
+    SimInf_valid_check *checks = NULL;
+    SimInf_valid_check total = {0};
+    const int *p = INTEGER(x);
+    R_xlen_t Nc = Rf_nrows(x), Nn = Rf_ncols(x);
+    int Nthread;
+
+    if (!Rf_isString(msg) || Rf_length(msg) != 1)
+        Rf_error("Invalid 'msg' argument.");
+
+    Nthread = SimInf_set_num_threads(Nn < INT_MAX ? (int)Nn : INT_MAX);
+    if (Nthread < 1)
+        Nthread = 1;
+    checks = calloc(Nthread, sizeof(SimInf_valid_check));
+    if (!checks)
+        Rf_error("Unable to allocate memory buffer."); /* #nocov */
+
+    #ifdef _OPENMP
+    #  pragma omp parallel for num_threads(Nthread)
+    #endif
+    for (int k = 0; k < Nthread; k++) {
+        const R_xlen_t chunk = Nn / Nthread + (Nn % Nthread ? 1 : 0);
+        const R_xlen_t end = (k + 1) * chunk < Nn ? (k + 1) * chunk : Nn;
+
+        for (R_xlen_t node = k * chunk; node < end; node++) {
+            for (R_xlen_t c = 0; c < Nc; c++) {
+                if (p[node * Nc + c] < 0) {
+                    SimInf_valid_check_add(&checks[k], node);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int k = 0; k < Nthread; k++)
+        SimInf_valid_check_merge(&total, &checks[k]);
+    free(checks);
+
+    if (total.count == 0)
+        return Rf_allocVector(STRSXP, 0);
+
+    PROTECT(result = Rf_allocVector(STRSXP, 1));
+    SET_STRING_ELT(result, 0, SimInf_valid_check_message(
+                       CHAR(STRING_ELT(msg, 0)), "node", &total));
+    UNPROTECT(1);
+
+    return result;
+}
@@ -40,7 +40,7 @@ enum {BETA, EPSILON, GAMMA};
  * @param t Current time.
  * @return propensity.
  */
-static double SEIR_S_to_E(
+static double SIMINF_TARGET_CLONES SEIR_S_to_E(
     const int *u,
     const double *v,
     const double *ldata,
@@ -70,7 +70,7 @@ static double SEIR_S_to_E(
  * @param t Current time.
  * @return propensity.
  */
-static double SEIR_E_to_I(
+static double SIMINF_TARGET_CLONES SEIR_E_to_I(
     const int *u,
     const double *v,
     const double *ldata,
@@ -94,7 +94,7 @@ static double SEIR_E_to_I(
  * @param t Current time.
  * @return propensity.
  */
-static double SEIR_I_to_R(
+static double SIMINF_TARGET_CLONES SEIR_I_to_R(
     const int *u,
     const double *v,
     const double *ldata,
@@ -40,7 +40,7 @@ enum {BETA, GAMMA};
  * @param t Current time.
  * @return propensity.
  */
-static double SIR_S_to_I(
+static double SIMINF_TARGET_CLONES SIR_S_to_I(
     const int *u,
     const double *v,
     const double *ldata,
@@ -70,7 +70,7 @@ static double SIR_S_to_I(
  * @param t Current time.
  * @return propensity.
  */
-static double SIR_I_to_R(
+static double SIMINF_TARGET_CLONES SIR_I_to_R(
     const int *u,
     const double *v,
     const double *ldata,
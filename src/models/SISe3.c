@@ -47,7 +47,7 @@ enum {UPSILON_1, UPSILON_2, UPSILON_3, GAMMA_1, GAMMA_2, GAMMA_3,
  * @param t Current time.
  * @return propensity.
  */
-static double SISe3_S_1_to_I_1(
+static double SIMINF_TARGET_CLONES SISe3_S_1_to_I_1(
     const int *u,
     const double *v,
     const double *ldata,
@@ -70,7 +70,7 @@ static double SISe3_S_1_to_I_1(
  * @param t Current time.
  * @return propensity.
  */
-static double SISe3_S_2_to_I_2(
+static double SIMINF_TARGET_CLONES SISe3_S_2_to_I_2(
     const int *u,
     const double *v,
     const double *ldata,
@@ -93,7 +93,7 @@ static double SISe3_S_2_to_I_2(
  * @param t Current time.
  * @return propensity.
  */
-static double SISe3_S_3_to_I_3(
+static double SIMINF_TARGET_CLONES SISe3_S_3_to_I_3(
     const int *u,
     const double *v,
     const double *ldata,
@@ -116,7 +116,7 @@ static double SISe3_S_3_to_I_3(
  * @param t Current time.
  * @return propensity.
  */
-static double SISe3_I_1_to_S_1(
+static double SIMINF_TARGET_CLONES SISe3_I_1_to_S_1(
     const int *u,
     const double *v,
     const double *ldata,
@@ -140,7 +140,7 @@ static double SISe3_I_1_to_S_1(
  * @param t Current time.
  * @return propensity.
  */
-static double SISe3_I_2_to_S_2(
+static double SIMINF_TARGET_CLONES SISe3_I_2_to_S_2(
     const int *u,
     const double *v,
     const double *ldata,
@@ -164,7 +164,7 @@ static double SISe3_I_2_to_S_2(
  * @param t Current time.
  * @return propensity
  */
-static double SISe3_I_3_to_S_3(
+static double SIMINF_TARGET_CLONES SISe3_I_3_to_S_3(
     const int *u,
     const double *v,
     const double *ldata,
@@ -46,7 +46,7 @@ enum {UPSILON, GAMMA, ALPHA, BETA_T1, BETA_T2, BETA_T3, BETA_T4, COUPLING};
  * @param t Current time.
  * @return propensity.
  */
-static double SISe_sp_S_to_I(
+static double SIMINF_TARGET_CLONES SISe_sp_S_to_I(
     const int *u,
     const double *v,
     const double *ldata,
@@ -69,7 +69,7 @@ static double SISe_sp_S_to_I(
  * @param t Current time.
  * @return propensity.
  */
-static double SISe_sp_I_to_S(
+static double SIMINF_TARGET_CLONES SISe_sp_I_to_S(
     const int *u,
     const double *v,
     const double *ldata,
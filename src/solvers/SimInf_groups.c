@@ -0,0 +1,81 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <R_ext/Visibility.h>
+
+#include "SimInf.h"
+#include "SimInf_solver.h"
+
+/**
+ * Update the group-level state.
+ *
+ * Sum each group state over the nodes in the group and write the sum
+ * to 'ldata' in every node of the group. The nodes where a group
+ * state changed are indicated for update of the transition rates.
+ * The groups are processed in parallel, and the function must be
+ * called by all threads in a parallel region, or outside a parallel
+ * region. The function must be called before the post time step
+ * function, when 'v' contains the continuous state.
+ *
+ * @param model The compartment model data for each thread.
+ */
+void attribute_hidden SIMINF_TARGET_CLONES
+SimInf_groups_update(SimInf_compartment_model *model)
+{
+    SimInf_groups *groups = model[0].groups;
+    const int Nc = model[0].Nc;
+    const int Nd = model[0].Nd;
+    const int Nld = model[0].Nld;
+    const int *u = model[0].u;
+    const double *v = model[0].v;
+    int *update_node = model[0].update_node;
+    int g;
+
+    #ifdef _OPENMP
+    #  pragma omp for
+    #endif
+    for (g = 0; g < groups->Ng; g++) {
+        int r;
+
+        for (r = 0; r < groups->Nrow; r++) {
+            const int state = groups->state[r];
+            double sum = 0.0;
+            int k;
+
+            if (state < Nc) {
+                for (k = groups->jc[g]; k < groups->jc[g + 1]; k++)
+                    sum += u[groups->ir[k] * Nc + state];
+            } else {
+                for (k = groups->jc[g]; k < groups->jc[g + 1]; k++)
+                    sum += v[groups->ir[k] * Nd + state - Nc];
+            }
+
+            for (k = groups->jc[g]; k < groups->jc[g + 1]; k++) {
+                const int node = groups->ir[k];
+                double *value = &groups->ldata[node * Nld + groups->row[r]];
+
+                if (*value != sum) {
+                    *value = sum;
+                    update_node[node] = 1;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,285 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <R_ext/Visibility.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <gsl/gsl_rng.h>
+
+#include "SimInf.h"
+#include "misc/SimInf_openmp.h"
+#include "SimInf_solver.h"
+
+/**
+ * Log-likelihood of an observation.
+ *
+ * @param pfilter The particle filter data.
+ * @param y The observed value.
+ * @param x The observed quantity in the particle.
+ * @return the log-likelihood of observing y given x.
+ */
+static double SimInf_pfilter_dlog(
+    const SimInf_pfilter *pfilter,
+    const int y,
+    const int x)
+{
+    const double p = pfilter->p;
+
+    switch (pfilter->dist) {
+    case SIMINF_PFILTER_POISSON:
+        if (p * x <= 0.0)
+            return y == 0 ? 0.0 : -INFINITY;
+        return y * log(p * x) - p * x - lgamma(y + 1.0);
+    case SIMINF_PFILTER_BINOMIAL:
+        if (y > x)
+            return -INFINITY;
+        if (p <= 0.0)
+            return y == 0 ? 0.0 : -INFINITY;
+        if (p >= 1.0)
+            return y == x ? 0.0 : -INFINITY;
+        return lgamma(x + 1.0) - lgamma(y + 1.0) - lgamma(x - y + 1.0) +
+            y * log(p) + (x - y) * log1p(-p);
+    }
+
+    return -INFINITY; /* #nocov */
+}
+
+/**
+ * Determine the observed quantity in a particle.
+ *
+ * @param pfilter The particle filter data.
+ * @param u The compartment state vector of all nodes.
+ * @param Nc Number of compartments in each node.
+ * @param particle The particle (zero-based).
+ * @param node The node (zero-based) within the particle to observe,
+ *        or -1 to observe the sum over all nodes in the particle.
+ * @return the sum of individuals in the observed compartments.
+ */
+static int SimInf_pfilter_observed(
+    const SimInf_pfilter *pfilter,
+    const int *u,
+    const int Nc,
+    const int particle,
+    const int node)
+{
+    int i, j, begin, end, x = 0;
+
+    begin = particle * pfilter->Nn;
+    end = begin + pfilter->Nn;
+    if (node >= 0) {
+        begin += node;
+        end = begin + 1;
+    }
+
+    for (i = begin; i < end; i++)
+        for (j = 0; j < pfilter->Ncompartments; j++)
+            x += u[i * Nc + pfilter->compartments[j]];
+
+    return x;
+}
+
+/**
+ * Weight and resample the particles.
+ *
+ * Process every time in tspan that has passed since the last
+ * update. At a time with observations, the particles are weighted
+ * with the likelihood of the observations, and the log-likelihood
+ * estimate and the effective sample size are updated. Then the
+ * particles are resampled with systematic resampling. The resampling
+ * is done in place: a particle with more than one offspring is
+ * copied into the blocks of particles without offspring, which keeps
+ * the particles with offspring untouched. Finally, the transition
+ * rates are recalculated in the nodes of the overwritten particles.
+ *
+ * The function must be called after the post time step when the
+ * pointers to 'v' and 'v_new' have been swapped.
+ *
+ * @param pfilter The particle filter data.
+ * @param model The compartment model data for each thread.
+ * @param rng The random number generator for resampling.
+ * @return 0 if Ok, 1 if all particles have zero likelihood i.e. the
+ *         simulation can be stopped, else error code.
+ */
+int attribute_hidden SimInf_pfilter_update(
+    SimInf_pfilter *pfilter,
+    SimInf_compartment_model *model,
+    gsl_rng *rng)
+{
+    const int Npart = pfilter->Npart;
+    const int Nc = model[0].Nc;
+    const int Nd = model[0].Nd;
+    const int Nthread = model[0].Nthread;
+    double *w = NULL;
+    int *offspring = NULL, *resampled = NULL;
+    int error = 0;
+
+    while (pfilter->tspan_it < model[0].tlen &&
+           model[0].tt > model[0].tspan[pfilter->tspan_it]) {
+        const int obs_begin = pfilter->obs_it;
+        double max_logw = -INFINITY, sum_w = 0.0, sum_w2 = 0.0, cum, r;
+        int i, j, k, obs_end = obs_begin;
+
+        /* Skip times without observations. */
+        while (obs_end < pfilter->Nobs &&
+               pfilter->obs_time[obs_end] == pfilter->tspan_it)
+            obs_end++;
+        pfilter->obs_it = obs_end;
+        if (obs_end == obs_begin) {
+            pfilter->tspan_it++;
+            continue;
+        }
+
+        if (!w) {
+            w = malloc(Npart * sizeof(double));
+            offspring = malloc(Npart * sizeof(int));
+            resampled = malloc(Npart * sizeof(int));
+            if (!w || !offspring || !resampled) {
+                error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+                goto cleanup;                           /* #nocov */
+            }
+        }
+
+        /* (1) Compute the log-weight of each particle. */
+        #ifdef _OPENMP
+        #  pragma omp parallel for num_threads(SimInf_num_threads())
+        #endif
+        for (k = 0; k < Npart; k++) {
+            int o;
+
+            w[k] = 0.0;
+            for (o = obs_begin; o < obs_end; o++) {
+                const int x = SimInf_pfilter_observed(
+                    pfilter, model[0].u, Nc, k, pfilter->obs_node[o]);
+                w[k] += SimInf_pfilter_dlog(pfilter, pfilter->obs_value[o], x);
+            }
+        }
+
+        for (k = 0; k < Npart; k++)
+            if (w[k] > max_logw)
+                max_logw = w[k];
+
+        /* No particle is compatible with the observations. */
+        if (max_logw == -INFINITY) {
+            pfilter->loglik = -INFINITY;
+            pfilter->ess[pfilter->tspan_it] = 0.0;
+            error = 1;
+            goto cleanup;
+        }
+
+        /* (2) Normalize the weights and update the log-likelihood
+         * estimate with the log of the mean weight. */
+        for (k = 0; k < Npart; k++) {
+            w[k] = exp(w[k] - max_logw);
+            sum_w += w[k];
+            sum_w2 += w[k] * w[k];
+        }
+        pfilter->loglik += max_logw + log(sum_w / Npart);
+        pfilter->ess[pfilter->tspan_it] = (sum_w * sum_w) / sum_w2;
+
+        /* (3) Systematic resampling: determine the number of
+         * offspring of each particle. */
+        memset(offspring, 0, Npart * sizeof(int));
+        r = gsl_rng_uniform(rng);
+        for (k = 0, j = 0, cum = w[0] / sum_w; k < Npart; k++) {
+            const double target = (k + r) / Npart;
+
+            while (j < Npart - 1 && cum < target)
+                cum += w[++j] / sum_w;
+            offspring[j]++;
+        }
+
+        /* (4) Copy particles with more than one offspring into the
+         * blocks of particles without offspring. */
+        memset(resampled, 0, Npart * sizeof(int));
+        for (j = 0, k = 0; j < Npart; j++) {
+            for (; offspring[j] > 1; offspring[j]--) {
+                const size_t src = (size_t)j * pfilter->Nn;
+                size_t dest;
+
+                while (offspring[k] > 0)
+                    k++;
+                dest = (size_t)k * pfilter->Nn;
+
+                memcpy(&model[0].u[dest * Nc], &model[0].u[src * Nc],
+                       pfilter->Nn * Nc * sizeof(int));
+                memcpy(&model[0].v[dest * Nd], &model[0].v[src * Nd],
+                       pfilter->Nn * Nd * sizeof(double));
+                memcpy(&model[0].v_new[dest * Nd], &model[0].v_new[src * Nd],
+                       pfilter->Nn * Nd * sizeof(double));
+                offspring[k] = 1;
+                resampled[k] = 1;
+            }
+        }
+
+        /* (5) Recalculate the transition rates in the nodes of the
+         * resampled particles. */
+        #ifdef _OPENMP
+        #  pragma omp parallel for num_threads(SimInf_num_threads())
+        #endif
+        for (i = 0; i < Nthread; i++) {
+            int node;
+            SimInf_compartment_model m = *&model[i];
+
+            for (node = 0; node < m.Nn; node++) {
+                int tr;
+
+                if (!resampled[(m.Ni + node) / pfilter->Nn])
+                    continue;
+
+                m.sum_t_rate[node] = 0.0;
+                for (tr = 0; tr < m.Nt; tr++) {
+                    const double rate = (*m.tr_fun[tr])(
+                        &m.u[node * m.Nc], &m.v[node * m.Nd],
+                        &m.ldata[node * m.Nld], m.gdata, m.tt);
+
+                    m.t_rate[node * m.Nt + tr] = rate;
+                    m.sum_t_rate[node] += m.t_rate[node * m.Nt + tr];
+                    if (!R_FINITE(rate) || rate < 0.0) {
+                        SimInf_print_status(m.Nc, &m.u[node * m.Nc],
+                                            m.Ni + node, m.tt, rate, tr);
+                        m.error = SIMINF_ERR_INVALID_RATE;
+                    }
+                }
+                SimInf_profile_rates(&m, node, m.Nt);
+
+                m.t_time[node] = m.tt;
+            }
+
+            *&model[i] = m;
+        }
+
+        for (i = 0; i < Nthread; i++) {
+            if (model[i].error) {
+                error = model[i].error;
+                goto cleanup;
+            }
+        }
+
+        pfilter->tspan_it++;
+    }
+
+cleanup:
+    free(w);
+    free(offspring);
+    free(resampled);
+
+    return error;
+}
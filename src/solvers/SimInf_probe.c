@@ -0,0 +1,146 @@
+/*
+ * This file is part of SimInf, a framework for stochastic
+ * disease spread simulations.
+ *
+ * Copyright (C) 2015 -- 2021 Stefan Widgren
+ *
+ * SimInf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SimInf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <R_ext/Visibility.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <gsl/gsl_rng.h>
+
+#include "SimInf.h"
+#include "SimInf_solver.h"
+
+/**
+ * Check if two transition rates differ.
+ *
+ * @param a The first rate.
+ * @param b The second rate.
+ * @return 1 if the rates differ, else 0.
+ */
+static int SimInf_probe_changed(const double a, const double b)
+{
+    if (isnan(a) && isnan(b))
+        return 0;
+    return a != b;
+}
+
+/**
+ * Determine the dependency graph by probing the transition rate
+ * functions.
+ *
+ * Each probe starts from the initial state of a node, where every
+ * compartment is randomly set to zero or perturbed. The transition
+ * rates are evaluated in the probed state, and then again after
+ * each transition has changed the state. If rate i changes when
+ * transition j occurs, then rate i depends on transition j. A probe
+ * never adds a false dependency, but a dependency can be missed if
+ * the rate does not change in any of the probed states.
+ *
+ * @param args Structure with data for the solver.
+ * @param n The number of probed states.
+ * @param G Integer matrix (Nt X Nt) that is set to 1 in element i of
+ *        column j if rate i depends on transition j. Must be
+ *        initialized to zero by the caller.
+ * @param rate Vector of length Nt with the mean of each rate in the
+ *        probed states.
+ * @return 0 if Ok, else error code.
+ */
+int attribute_hidden SimInf_probe_dependency_graph(
+    const SimInf_solver_args *args,
+    const int n,
+    int *G,
+    double *rate)
+{
+    const int Nc = args->Nc;
+    const int Nt = args->Nt;
+    const double t = args->tspan[0];
+    gsl_rng *rng = NULL;
+    int *u = NULL, *u_new = NULL;
+    double *t_rate = NULL;
+    int error = 0, k;
+
+    rng = gsl_rng_alloc(gsl_rng_mt19937);
+    u = malloc(Nc * sizeof(int));
+    u_new = malloc(Nc * sizeof(int));
+    t_rate = malloc(Nt * sizeof(double));
+    if (!rng || !u || !u_new || !t_rate) {
+        error = SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+        goto cleanup;                           /* #nocov */
+    }
+    gsl_rng_set(rng, args->seed);
+
+    memset(rate, 0, Nt * sizeof(double));
+
+    for (k = 0; k < n; k++) {
+        const int node = k % args->Nn;
+        const double *v = &args->v0[node * args->Nd];
+        const double *ldata = &args->ldata[node * args->Nld];
+        int c, i, j;
+
+        /* Perturb the initial state of the node. Every fourth
+         * compartment is set to zero on average, to probe rates that
+         * depend on empty compartments. */
+        for (c = 0; c < Nc; c++) {
+            if (gsl_rng_uniform(rng) < 0.25)
+                u[c] = 0;
+            else
+                u[c] = gsl_rng_uniform_int(rng, 2 * args->u0[node * Nc + c] + 10);
+        }
+
+        for (i = 0; i < Nt; i++) {
+            t_rate[i] = (*args->tr_fun[i])(u, v, ldata, args->gdata, t);
+            if (R_FINITE(t_rate[i]))
+                rate[i] += t_rate[i] / n;
+        }
+
+        for (j = 0; j < Nt; j++) {
+            int negative = 0;
+
+            memcpy(u_new, u, Nc * sizeof(int));
+            for (i = args->jcS[j]; i < args->jcS[j + 1]; i++) {
+                u_new[args->irS[i]] += args->prS[i];
+                if (u_new[args->irS[i]] < 0)
+                    negative = 1;
+            }
+
+            /* The transition cannot occur in this state. */
+            if (negative)
+                continue;
+
+            for (i = 0; i < Nt; i++) {
+                if (!G[j * Nt + i]) {
+                    const double r = (*args->tr_fun[i])(
+                        u_new, v, ldata, args->gdata, t);
+
+                    if (SimInf_probe_changed(t_rate[i], r))
+                        G[j * Nt + i] = 1;
+                }
+            }
+        }
+    }
+
+cleanup:
+    gsl_rng_free(rng);
+    free(u);
+    free(u_new);
+    free(t_rate);
+
+    return error;
+}
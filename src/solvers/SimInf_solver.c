@@ -311,12 +311,15 @@ static int SimInf_sample_select_enter(
  * Thread id 0 is the main thread. All E2 events are assigned to
  * thread id 0.
  *
- * All E1 events for a node are assigned to the same thread.
+ * All E1 events for a node are assigned to the same thread. An
+ * internal transfer event in all nodes (node = 0) is assigned to
+ * every thread.
  *
  * @param len Number of scheduled events.
  * @param event The type of event i.
  * @param time The time of event i.
- * @param node The source node index (one based) of event i.
+ * @param node The source node index (one based) of event i, or 0
+ *        for an internal transfer event in all nodes.
  * @param dest The dest node index (one-based) of event i.
  * @param n The number of individuals in event i. n[i] >= 0.
  * @param proportion If n[i] equals zero, then the number of
@@ -343,10 +346,15 @@ static void SimInf_split_events(
     for (i = 0; i < len; i++) {
         const SimInf_scheduled_event e = {event[i], time[i], node[i] - 1,
                                           dest[i] - 1, n[i], proportion[i],
-                                          select[i] - 1, shift[i] - 1};
+                                          select[i] - 1, shift[i] - 1, i};
 
         if (event[i] == EXTERNAL_TRANSFER_EVENT) {
             kv_push(SimInf_scheduled_event, out[0].events, e);
+        } else if (event[i] == INTERNAL_TRANSFER_EVENT && node[i] == 0) {
+            /* An internal transfer event in all nodes is processed
+             * by each thread in its own nodes. */
+            for (int j = 0; j < Nthread; j++)
+                kv_push(SimInf_scheduled_event, out[j].events, e);
         } else {
             int j = (node[i] - 1) / chunk_size;
             if (j >= Nthread)
@@ -388,6 +396,15 @@ int attribute_hidden SimInf_scheduled_events_create(
         /* Scheduled events */
 	kv_init(events[i].events);
 
+        /* Recurring events */
+        events[i].period = args->period;
+        events[i].end = args->end;
+        kv_init(events[i].recurring);
+
+        /* Log of event outcomes */
+        events[i].log_outcomes = args->log_outcomes;
+        kv_init(events[i].outcomes);
+
         events[i].individuals = calloc(args->Nc, sizeof(int));
         if (!events[i].individuals)
             goto on_error; /* #nocov */
@@ -430,6 +447,8 @@ void attribute_hidden SimInf_scheduled_events_free(
 
             if (e) {
                 kv_destroy(e->events);
+                kv_destroy(e->recurring);
+                kv_destroy(e->outcomes);
                 free(e->individuals);
                 e->individuals = NULL;
                 gsl_rng_free(e->rng);
@@ -441,6 +460,79 @@ void attribute_hidden SimInf_scheduled_events_free(
     }
 }
 
+/**
+ * Compare the order of two event outcomes by the time when the event
+ * was processed and the index of the event.
+ */
+static int SimInf_event_outcome_cmp(
+    const SimInf_event_outcome *a,
+    const SimInf_event_outcome *b)
+{
+    if (a->time != b->time)
+        return a->time < b->time ? -1 : 1;
+    return a->id - b->id;
+}
+
+/**
+ * Merge the log of event outcomes from each thread.
+ *
+ * The outcomes in the log of each thread are in the order that the
+ * events were processed, i.e., in the order of the scheduled events
+ * and the occurrences of the recurring events. The logs are
+ * therefore merged by the time and the index of the events, which
+ * gives the outcomes from all threads in time order.
+ *
+ * @param args Structure with data for the solver. The merged log is
+ *        stored in 'args->outcomes' and must be freed by the caller.
+ * @param events The scheduled events for each thread.
+ * @return 0 or an error code
+ */
+int attribute_hidden SimInf_scheduled_events_outcomes(
+    SimInf_solver_args *args,
+    const SimInf_scheduled_events *events)
+{
+    size_t i, n = 0, *index = NULL;
+
+    if (!args->log_outcomes)
+        return 0;
+
+    for (i = 0; i < (size_t)args->Nthread; i++)
+        n += kv_size(events[i].outcomes);
+    if (n == 0)
+        return 0;
+
+    index = calloc(args->Nthread, sizeof(size_t));
+    args->outcomes = malloc(n * sizeof(SimInf_event_outcome));
+    if (!index || !args->outcomes) {
+        free(index);                           /* #nocov */
+        free(args->outcomes);                  /* #nocov */
+        args->outcomes = NULL;                 /* #nocov */
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+    }
+
+    for (i = 0; i < n; i++) {
+        int j, next = -1;
+
+        for (j = 0; j < args->Nthread; j++) {
+            if (index[j] < kv_size(events[j].outcomes) &&
+                (next < 0 ||
+                 SimInf_event_outcome_cmp(
+                     &kv_A(events[j].outcomes, index[j]),
+                     &kv_A(events[next].outcomes, index[next])) < 0))
+            {
+                next = j;
+            }
+        }
+
+        args->outcomes[i] = kv_A(events[next].outcomes, index[next]++);
+    }
+
+    args->n_outcomes = n;
+    free(index);
+
+    return 0;
+}
+
 /**
  * Print event information to facilitate debugging.
  *
@@ -549,6 +641,258 @@ static void SimInf_print_event(
     }
 }
 
+/**
+ * Log the number of individuals that were sampled from each
+ * compartment in an event.
+ *
+ * @param e Data with events to process.
+ * @param ee The processed event.
+ * @param node The node (zero-based) that the individuals were
+ *        sampled from.
+ */
+static void SimInf_log_outcomes(
+    SimInf_scheduled_events *e,
+    const SimInf_scheduled_event *ee,
+    const int node)
+{
+    for (int i = e->jcE[ee->select]; i < e->jcE[ee->select + 1]; i++) {
+        const int jj = e->irE[i];
+
+        if (e->individuals[jj] > 0) {
+            const SimInf_event_outcome o = {ee->id, ee->time, node, jj,
+                                            e->individuals[jj]};
+            kv_push(SimInf_event_outcome, e->outcomes, o);
+        }
+    }
+}
+
+/**
+ * Count a scheduled event and the sampled individuals in the node
+ * that the individuals were sampled from.
+ *
+ * @param m The compartment model with information for each node.
+ * @param e Data with events to process.
+ * @param ee The processed event.
+ * @param node The node (relative to the first node in the thread)
+ *        that the individuals were sampled from.
+ * @param cycles The cycle counter when the processing of the event
+ *        started, see SimInf_profile_cycles.
+ */
+static void SimInf_profile_event(
+    SimInf_compartment_model *m,
+    const SimInf_scheduled_events *e,
+    const SimInf_scheduled_event *ee,
+    const int node,
+    const unsigned long long cycles)
+{
+    if (m->profile) {
+        for (int i = e->jcE[ee->select]; i < e->jcE[ee->select + 1]; i++)
+            m->profile[node].individuals += e->individuals[e->irE[i]];
+        m->profile[node].events += 1.0;
+        SimInf_profile_elapsed(m, node, cycles);
+    }
+}
+
+/**
+ * Process an internal transfer event in one node, i.e., sample
+ * individuals from the compartments determined by 'select' and
+ * shift them to the compartments determined by 'shift'.
+ *
+ * @param m The compartment model with information for each node.
+ * @param e Data with events to process.
+ * @param ee The internal transfer event to process.
+ * @param node The node (relative to the first node in the thread)
+ *        to process the event in.
+ * @return 0 if Ok, else error code.
+ */
+static int SimInf_internal_transfer(
+    SimInf_compartment_model *m,
+    SimInf_scheduled_events *e,
+    const SimInf_scheduled_event *ee,
+    const int node)
+{
+    int error;
+
+    error = SimInf_sample_select(
+        e->irE, e->jcE, e->prE, m->Nc, m->u, node, ee->select,
+        ee->n, ee->proportion, e->individuals, e->rng);
+
+    if (error) {
+        SimInf_print_event(ee, e->irE, e->jcE, m->Nc, m->u, node, -1);
+        return error;
+    }
+
+    for (int i = e->jcE[ee->select]; i < e->jcE[ee->select + 1]; i++) {
+        const int jj = e->irE[i];
+        const int kn = node * m->Nc + jj;
+        const int ll = e->N[ee->shift * m->Nc + jj];
+
+        /* Check that the index to the new compartment is not out of
+         * bounds. */
+        if (jj + ll < 0 || jj + ll >= m->Nc) {
+            SimInf_print_event(ee, NULL, NULL, 0, NULL, -1, -1);
+            return SIMINF_ERR_SHIFT_OUT_OF_BOUNDS;
+        }
+
+        /* Add individuals to new compartments in node */
+        m->u[kn + ll] += e->individuals[jj];
+        if (m->u[kn + ll] < 0) {
+            SimInf_print_event(ee, NULL, NULL, m->Nc, m->u, node, -1);
+            return SIMINF_ERR_NEGATIVE_STATE;
+        }
+
+        /* Remove individuals from previous compartments in node */
+        m->u[kn] -= e->individuals[jj];
+        if (m->u[kn] < 0) {
+            SimInf_print_event(ee, NULL, NULL, m->Nc, m->u, node, -1);
+            return SIMINF_ERR_NEGATIVE_STATE;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Compare the order of two scheduled events. The events are ordered
+ * by time, event type, select and the index of the event, which is
+ * the order of the scheduled events.
+ *
+ * @return a negative value if a is before b, else a positive value
+ *         or zero.
+ */
+static int SimInf_event_cmp(
+    const SimInf_scheduled_event *a,
+    const SimInf_scheduled_event *b)
+{
+    if (a->time != b->time)
+        return a->time < b->time ? -1 : 1;
+    if (a->event != b->event)
+        return a->event < b->event ? -1 : 1;
+    if (a->select != b->select)
+        return a->select < b->select ? -1 : 1;
+    return a->id - b->id;
+}
+
+/**
+ * Add the next occurrence of a recurring event to the binary heap
+ * of recurring events.
+ *
+ * @param heap The binary heap with recurring events.
+ * @param ee The next occurrence of the event.
+ */
+static void SimInf_recurring_push(
+    SimInf_events_t *heap,
+    const SimInf_scheduled_event *ee)
+{
+    size_t i;
+
+    kv_push(SimInf_scheduled_event, *heap, *ee);
+    for (i = kv_size(*heap) - 1; i > 0; i = (i - 1) / 2) {
+        const size_t parent = (i - 1) / 2;
+        SimInf_scheduled_event tmp;
+
+        if (SimInf_event_cmp(&kv_A(*heap, parent), &kv_A(*heap, i)) <= 0)
+            break;
+        tmp = kv_A(*heap, parent);
+        kv_A(*heap, parent) = kv_A(*heap, i);
+        kv_A(*heap, i) = tmp;
+    }
+}
+
+/**
+ * Remove the first recurring event from the binary heap of
+ * recurring events.
+ *
+ * @param heap The binary heap with recurring events.
+ */
+static void SimInf_recurring_pop(SimInf_events_t *heap)
+{
+    size_t i = 0, n = kv_size(*heap) - 1;
+
+    kv_A(*heap, 0) = kv_pop(*heap);
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        SimInf_scheduled_event tmp;
+
+        if (child >= n)
+            break;
+        if (child + 1 < n &&
+            SimInf_event_cmp(&kv_A(*heap, child + 1), &kv_A(*heap, child)) < 0)
+            child++;
+        if (SimInf_event_cmp(&kv_A(*heap, i), &kv_A(*heap, child)) <= 0)
+            break;
+        tmp = kv_A(*heap, i);
+        kv_A(*heap, i) = kv_A(*heap, child);
+        kv_A(*heap, child) = tmp;
+        i = child;
+    }
+}
+
+/**
+ * Determine the next event to process: either the next scheduled
+ * event or the next occurrence of a recurring event.
+ *
+ * @param e Data with events to process.
+ * @param ee The next event.
+ * @param recurring Set to 1 if the next event is from the heap of
+ *        recurring events, else 0.
+ * @return 1 if there is an event to process, else 0.
+ */
+static int SimInf_next_event(
+    const SimInf_scheduled_events *e,
+    SimInf_scheduled_event *ee,
+    int *recurring)
+{
+    const int scheduled = e->events_index < kv_size(e->events);
+
+    if (kv_size(e->recurring) &&
+        (!scheduled || SimInf_event_cmp(&kv_A(e->recurring, 0),
+                                        &kv_A(e->events, e->events_index)) < 0))
+    {
+        *ee = kv_A(e->recurring, 0);
+        *recurring = 1;
+        return 1;
+    }
+
+    if (scheduled) {
+        *ee = kv_A(e->events, e->events_index);
+        *recurring = 0;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Remove a processed event, and schedule the next occurrence if it
+ * is a recurring event, i.e., the recurring events are expanded one
+ * occurrence at a time when they are processed.
+ *
+ * @param e Data with events to process.
+ * @param ee The processed event.
+ * @param recurring 1 if the event is from the heap of recurring
+ *        events, else 0.
+ */
+static void SimInf_pop_event(
+    SimInf_scheduled_events *e,
+    const SimInf_scheduled_event *ee,
+    int recurring)
+{
+    if (recurring)
+        SimInf_recurring_pop(&e->recurring);
+    else
+        e->events_index++;
+
+    if (e->period && e->period[ee->id] > 0 &&
+        ee->time <= e->end[ee->id] - e->period[ee->id]) {
+        SimInf_scheduled_event next = *ee;
+
+        next.time += e->period[ee->id];
+        SimInf_recurring_push(&e->recurring, &next);
+    }
+}
+
 /**
  * Process all scheduled E1 and E2 events where time is less or equal
  * to the global time in the simulation.
@@ -569,13 +913,17 @@ void attribute_hidden SimInf_process_events(
     SimInf_scheduled_events e = *&events[0];
 
     /* Process events */
-    while (e.events_index < kv_size(e.events) && !m.error) {
-        const SimInf_scheduled_event ee = kv_A(e.events, e.events_index);
+    while (!m.error) {
+        SimInf_scheduled_event ee;
+        unsigned long long cycles;
+        int recurring;
 
-        if (ee.time > m.tt)
+        if (!SimInf_next_event(&e, &ee, &recurring) || ee.time > m.tt)
             goto done;
+        cycles = SimInf_profile_cycles(&m);
 
-        if (ee.node < 0 || ee.node >= m.Ntot) {
+        if ((ee.node < 0 && ee.event != INTERNAL_TRANSFER_EVENT) ||
+            ee.node >= m.Ntot) {
             SimInf_print_event(&ee, NULL, NULL, 0, NULL, -1, -1);
             m.error = SIMINF_ERR_NODE_OUT_OF_BOUNDS;
             goto done;
@@ -678,48 +1026,49 @@ void attribute_hidden SimInf_process_events(
                 goto done;
             }
 
-            m.error = SimInf_sample_select(
-                e.irE, e.jcE, e.prE, m.Nc, m.u, ee.node - m.Ni, ee.select,
-                ee.n, ee.proportion, e.individuals, e.rng);
-
-            if (m.error) {
-                SimInf_print_event(&ee, e.irE, e.jcE, m.Nc,
-                                   m.u, ee.node - m.Ni, -1);
-                goto done;
-            }
-
-            for (int i = e.jcE[ee.select]; i < e.jcE[ee.select + 1]; i++) {
-                const int jj = e.irE[i];
-                const int kn = (ee.node - m.Ni) * m.Nc + jj;
-                const int ll = e.N[ee.shift * m.Nc + jj];
-
-                /* Check that the index to the new compartment is not
-                 * out of bounds. */
-                if (jj + ll < 0 || jj + ll >= m.Nc) {
-                    SimInf_print_event(&ee, NULL, NULL, 0, NULL, -1, -1);
-                    m.error = SIMINF_ERR_SHIFT_OUT_OF_BOUNDS;
-                    goto done;
-                }
+            if (ee.node < 0) {
+                /* Process the event in every node of the thread, and
+                 * log the outcome of each node. A fixed number of
+                 * individuals 'n' is clamped to the number of
+                 * individuals in the selected compartments of each
+                 * node, since the nodes can differ in size. */
+                for (int node = 0; node < m.Nn; node++) {
+                    SimInf_scheduled_event en = ee;
+
+                    if (en.n > 0) {
+                        int Nindividuals = 0;
+
+                        for (int i = e.jcE[en.select];
+                             i < e.jcE[en.select + 1]; i++) {
+                            Nindividuals += m.u[node * m.Nc + e.irE[i]];
+                        }
+
+                        /* An empty node samples a proportion of zero
+                         * individuals, since n = 0 means that the
+                         * proportion is used. */
+                        if (en.n > Nindividuals) {
+                            en.n = Nindividuals;
+                            if (en.n == 0)
+                                en.proportion = 0.0;
+                        }
+                    }
 
-                /* Add individuals to new compartments in node */
-                m.u[kn + ll] += e.individuals[jj];
-                if (m.u[kn + ll] < 0) {
-                    SimInf_print_event(&ee, NULL, NULL, m.Nc,
-                                       m.u, ee.node - m.Ni, -1);
-                    m.error = SIMINF_ERR_NEGATIVE_STATE;
-                    goto done;
+                    m.error = SimInf_internal_transfer(&m, &e, &en, node);
+                    if (m.error)
+                        goto done;
+                    if (e.log_outcomes)
+                        SimInf_log_outcomes(&e, &en, m.Ni + node);
+                    SimInf_profile_event(&m, &e, &en, node, cycles);
+                    cycles = SimInf_profile_cycles(&m);
+                    m.update_node[node] = 1;
                 }
 
-                /* Remove individuals from previous compartments in
-                 * node */
-                m.u[kn] -= e.individuals[jj];
-                if (m.u[kn] < 0) {
-                    SimInf_print_event(&ee, NULL, NULL, m.Nc,
-                                       m.u, ee.node - m.Ni, -1);
-                    m.error = SIMINF_ERR_NEGATIVE_STATE;
-                    goto done;
-                }
+                break;
             }
+
+            m.error = SimInf_internal_transfer(&m, &e, &ee, ee.node - m.Ni);
+            if (m.error)
+                goto done;
             break;
 
         case EXTERNAL_TRANSFER_EVENT:
@@ -807,10 +1156,19 @@ void attribute_hidden SimInf_process_events(
             break;
         }
 
-        /* Indicate node for update */
-        m.update_node[ee.node - m.Ni] = 1;
+        if (ee.node >= 0) {
+            /* Log the number of individuals that were sampled from
+             * each compartment. */
+            if (e.log_outcomes)
+                SimInf_log_outcomes(&e, &ee, ee.node);
 
-        e.events_index++;
+            SimInf_profile_event(&m, &e, &ee, ee.node - m.Ni, cycles);
+
+            /* Indicate node for update */
+            m.update_node[ee.node - m.Ni] = 1;
+        }
+
+        SimInf_pop_event(&e, &ee, recurring);
     }
 
 done:
@@ -818,6 +1176,108 @@ done:
     *&model[0] = m;
 }
 
+/**
+ * Check a transition rate and raise an invalid rate error in the
+ * model if the rate is not finite or negative.
+ *
+ * @param m the compartment model data of the thread.
+ * @param node the node (zero-based) in the thread.
+ * @param j the transition (zero-based).
+ * @param rate the transition rate as stored in the rate matrix.
+ */
+static void
+SimInf_check_rate(
+    SimInf_compartment_model *m,
+    const int node,
+    const int j,
+    const double rate)
+{
+    if (!R_FINITE(rate) || rate < 0.0) {
+        SimInf_print_status(m->Nc, &m->u[node * m->Nc],
+                            m->Ni + node, m->tt, rate, j);
+        m->error = SIMINF_ERR_INVALID_RATE;
+    }
+}
+
+/**
+ * Initialize the transition rate for every transition and every node
+ * in the thread.
+ *
+ * @param m the compartment model data of the thread.
+ */
+void attribute_hidden SIMINF_TARGET_CLONES
+SimInf_init_rates(SimInf_compartment_model *m)
+{
+    for (int node = 0; node < m->Nn; node++) {
+        for (int j = 0; j < m->Nt; j++) {
+            const double rate = (*m->tr_fun[j])(
+                &m->u[node * m->Nc], &m->v[node * m->Nd],
+                &m->ldata[node * m->Nld], m->gdata, m->tt);
+
+            m->t_rate[node * m->Nt + j] = rate;
+            SimInf_check_rate(m, node, j, m->t_rate[node * m->Nt + j]);
+        }
+        SimInf_profile_rates(m, node, m->Nt);
+    }
+}
+
+/**
+ * Handle the case where the solution is stored in a dense matrix
+ *
+ * Store the solution of the nodes in the thread if tt has passed
+ * the next time in tspan. Report solution up to, but not including
+ * tt. The default is to copy the node-major state of the nodes as
+ * one block, where U(node * Nc + c, j) is compartment c in
+ * node. If 'compartment_major' is non-zero, the state is scattered
+ * to U(c * Nn + node, j) instead, such that the trajectory of a
+ * single compartment is contiguous in U. The same applies to V.
+ *
+ * @param SimInf_compartment_model *model data to store.
+ */
+void attribute_hidden
+SimInf_store_solution_dense(SimInf_compartment_model *model)
+{
+    const int Nn = model->Nn;
+    const int Nc = model->Nc;
+    const int Nd = model->Nd;
+    const int Ntot = model->Ntot;
+    const int Ni = model->Ni;
+
+    while (model->U && model->U_it < model->tlen &&
+           model->tt > model->tspan[model->U_it]) {
+        if (model->compartment_major) {
+            int *U = &model->U[Nc * Ntot * model->U_it + Ni];
+            int c, node;
+
+            for (c = 0; c < Nc; c++) {
+                for (node = 0; node < Nn; node++)
+                    U[c * Ntot + node] = model->u[node * Nc + c];
+            }
+        } else {
+            memcpy(&model->U[Nc * ((Ntot * model->U_it) + Ni)],
+                   model->u, Nn * Nc * sizeof(int));
+        }
+        model->U_it++;
+    }
+
+    while (model->V && model->V_it < model->tlen &&
+           model->tt > model->tspan[model->V_it]) {
+        if (model->compartment_major) {
+            double *V = &model->V[Nd * Ntot * model->V_it + Ni];
+            int d, node;
+
+            for (d = 0; d < Nd; d++) {
+                for (node = 0; node < Nn; node++)
+                    V[d * Ntot + node] = model->v_new[node * Nd + d];
+            }
+        } else {
+            memcpy(&model->V[Nd * ((Ntot * model->V_it) + Ni)],
+                   model->v_new, Nn * Nd * sizeof(double));
+        }
+        model->V_it++;
+    }
+}
+
 /**
  * Handle the case where the solution is stored in a sparse matrix
  *
@@ -826,7 +1286,7 @@ done:
  *
  * @param SimInf_compartment_model *model data to store.
  */
-void attribute_hidden
+void attribute_hidden SIMINF_TARGET_CLONES
 SimInf_store_solution_sparse(SimInf_compartment_model *model)
 {
     while (!model[0].U && model[0].U_it < model[0].tlen &&
@@ -875,6 +1335,7 @@ SimInf_compartment_model_free(SimInf_compartment_model *model)
                 m->sum_t_rate = NULL;
                 free(m->t_time);
                 m->t_time = NULL;
+                kv_destroy(m->transitions);
             }
         }
 
@@ -947,6 +1408,7 @@ int attribute_hidden SimInf_compartment_model_create(
         model[i].Nc = args->Nc;
         model[i].Nd = args->Nd;
         model[i].Nld = args->Nld;
+        model[i].Nblock = args->pfilter ? args->pfilter->Nn : args->Nn;
 
         /* Sparse matrices */
         model[i].irG = args->irG;
@@ -966,6 +1428,7 @@ int attribute_hidden SimInf_compartment_model_create(
         model[i].tlen = args->tlen;
         model[i].U_it = 0;
         model[i].V_it = 0;
+        model[i].compartment_major = args->compartment_major;
 
         /* Data vectors */
         if (args->U) {
@@ -993,12 +1456,18 @@ int attribute_hidden SimInf_compartment_model_create(
 
         model[i].ldata = &(args->ldata[model[i].Ni * model[i].Nld]);
         model[i].gdata = args->gdata;
+        model[i].groups = args->groups;
+        if (args->sentinel)
+            model[i].sentinel = &args->sentinel[model[i].Ni];
+        model[i].trace = args->trace;
+        if (args->profile)
+            model[i].profile = &args->profile[model[i].Ni];
 
         /* Create transition rate matrix (Nt X Nn) and total rate
          * vector. In t_rate we store all propensities for state
          * transitions, and in sum_t_rate the sum of propensities in
          * every node. */
-        model[i].t_rate = malloc(args->Nt * model[i].Nn * sizeof(double));
+        model[i].t_rate = malloc(args->Nt * model[i].Nn * sizeof(SimInf_rate_t));
         if (!model[i].t_rate)
             goto on_error; /* #nocov */
         model[i].sum_t_rate = malloc(model[i].Nn * sizeof(double));
@@ -1017,6 +1486,68 @@ on_error:                                  /* #nocov */
     return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
 }
 
+/**
+ * Compare the order of two transition records by the time and the
+ * node.
+ */
+static int SimInf_transition_record_cmp(const void *a, const void *b)
+{
+    const SimInf_transition_record *x = a;
+    const SimInf_transition_record *y = b;
+
+    if (x->time != y->time)
+        return x->time < y->time ? -1 : 1;
+    return x->node - y->node;
+}
+
+/**
+ * Merge the transitions in the sentinel nodes from each thread.
+ *
+ * Each thread records the transitions node by node during a time
+ * step, so the records from all threads are collected and sorted by
+ * time and node.
+ *
+ * @param args Structure with data for the solver. The merged records
+ *        are stored in 'args->transitions' and must be freed by the
+ *        caller.
+ * @param model The compartment model data for each thread.
+ * @return 0 or an error code
+ */
+int attribute_hidden SimInf_compartment_model_transitions(
+    SimInf_solver_args *args,
+    const SimInf_compartment_model *model)
+{
+    size_t n = 0;
+    int i;
+
+    if (!args->sentinel)
+        return 0;
+
+    for (i = 0; i < args->Nthread; i++)
+        n += kv_size(model[i].transitions);
+    if (n == 0)
+        return 0;
+
+    args->transitions = malloc(n * sizeof(SimInf_transition_record));
+    if (!args->transitions)
+        return SIMINF_ERR_ALLOC_MEMORY_BUFFER; /* #nocov */
+
+    for (i = 0; i < args->Nthread; i++) {
+        if (kv_size(model[i].transitions)) {
+            memcpy(&args->transitions[args->n_transitions],
+                   model[i].transitions.a,
+                   kv_size(model[i].transitions) *
+                   sizeof(SimInf_transition_record));
+            args->n_transitions += kv_size(model[i].transitions);
+        }
+    }
+
+    qsort(args->transitions, n, sizeof(SimInf_transition_record),
+          SimInf_transition_record_cmp);
+
+    return 0;
+}
+
 /**
  * Print node status/information to facilitate debugging.
  *
@@ -24,9 +24,11 @@
 #ifndef INCLUDE_SIMINF_SOLVER_H
 #define INCLUDE_SIMINF_SOLVER_H
 
+#include <time.h>
 #include <gsl/gsl_rng.h>
 
 #include "misc/kvec.h"
+#include "misc/SimInf_openmp.h"
 #include "SimInf.h"
 
 /**
@@ -53,6 +55,213 @@ enum {EXIT_EVENT,
       INTERNAL_TRANSFER_EVENT,
       EXTERNAL_TRANSFER_EVENT};
 
+/**
+ * The storage type of the transition rates in the solvers.
+ *
+ * Build with '-DSIMINF_FLOAT_RATES' to store the transition rates in
+ * single precision, e.g., 'R CMD INSTALL SimInf
+ * --configure-vars="CPPFLAGS=-DSIMINF_FLOAT_RATES"'. This halves the
+ * memory traffic of the rate matrix in models with many nodes and
+ * transitions. The transition rate functions still return a double,
+ * that is rounded when stored, and the sum of the rates in each node
+ * is accumulated in double precision from the stored rates. The
+ * solvers validate the stored rate, so a finite rate that overflows
+ * the storage type is reported as an invalid rate. Use
+ * 'benchmark/solvers.R' to compare with the default build.
+ */
+#if defined(SIMINF_FLOAT_RATES)
+typedef float SimInf_rate_t;
+#else
+typedef double SimInf_rate_t;
+#endif
+
+/**
+ * Structure with the number of individuals that were sampled from a
+ * compartment when processing a scheduled event.
+ */
+typedef struct SimInf_event_outcome
+{
+    int id;          /**< The index (zero-based) of the event in the
+                      *   scheduled events. */
+    int time;        /**< The time when the event was processed. */
+    int node;        /**< The node (zero-based) that the
+                      *   individuals were sampled from. */
+    int compartment; /**< The compartment (zero-based) that the
+                      *   individuals were sampled from. */
+    int n;           /**< The number of sampled individuals. */
+} SimInf_event_outcome;
+
+typedef kvec_t(SimInf_event_outcome) SimInf_event_outcomes_t;
+
+/**
+ * Structure with a transition that occurred in a sentinel node.
+ */
+typedef struct SimInf_transition_record
+{
+    double time;    /**< The time when the transition occurred. */
+    int node;       /**< The node (zero-based). */
+    int transition; /**< The transition (zero-based). */
+} SimInf_transition_record;
+
+typedef kvec_t(SimInf_transition_record) SimInf_transition_records_t;
+
+/**
+ * The phases of a time step that are traced in the solvers.
+ *
+ * SIMINF_TRACE_TRANSITIONS (0): The continuous-time Markov chain in
+ * the nodes of a thread.
+ *
+ * SIMINF_TRACE_E1 (1): The scheduled E1 events in the nodes of a
+ * thread.
+ *
+ * SIMINF_TRACE_WAIT (2): The wait at the barriers around the E2
+ * events that are processed by the master thread.
+ *
+ * SIMINF_TRACE_E2 (3): The scheduled E2 events.
+ *
+ * SIMINF_TRACE_PTS (4): The post time step function and the update
+ * of the transition rates.
+ */
+enum {SIMINF_TRACE_TRANSITIONS,
+      SIMINF_TRACE_E1,
+      SIMINF_TRACE_WAIT,
+      SIMINF_TRACE_E2,
+      SIMINF_TRACE_PTS,
+      SIMINF_TRACE_N_PHASES};
+
+/**
+ * Structure with the wall-clock time of a traced phase.
+ */
+typedef struct SimInf_trace_record
+{
+    int phase;    /**< The traced phase. */
+    double time;  /**< The time in the simulation when the time step
+                   *   started. */
+    double begin; /**< The wall-clock time (seconds) when the phase
+                   *   began. */
+    double end;   /**< The wall-clock time (seconds) when the phase
+                   *   ended. */
+} SimInf_trace_record;
+
+/**
+ * Structure with a preallocated ring buffer of trace records for a
+ * thread. When the buffer is full, the oldest record is overwritten.
+ */
+typedef struct SimInf_trace
+{
+    SimInf_trace_record *records; /**< The ring buffer. */
+    size_t capacity;              /**< The number of records that
+                                   *   fit in the ring buffer. */
+    size_t n;                     /**< The number of records that
+                                   *   have been written. */
+} SimInf_trace;
+
+/**
+ * Structure with the cost counters of a node.
+ */
+typedef struct SimInf_node_profile
+{
+    double transitions;      /**< The number of transitions that
+                              *   occurred in the node. */
+    double rate_evaluations; /**< The number of evaluated transition
+                              *   rates in the node. */
+    double events;           /**< The number of scheduled events that
+                              *   sampled individuals from the
+                              *   node. */
+    double individuals;      /**< The number of individuals that were
+                              *   sampled from the node by the
+                              *   scheduled events. */
+    double cycles;           /**< The number of processor cycles spent
+                              *   in the node. */
+} SimInf_node_profile;
+
+/* The processor cycles are read with the time-stamp counter on x86
+ * processors, else the cycles are not counted. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SIMINF_HAVE_CYCLES 1
+#else
+#  define SIMINF_HAVE_CYCLES 0
+#endif
+
+/**
+ * Observation distributions in the particle filter.
+ */
+enum {SIMINF_PFILTER_POISSON,
+      SIMINF_PFILTER_BINOMIAL};
+
+/**
+ * Structure with data for a bootstrap particle filter.
+ *
+ * The nodes in the model are divided into Npart blocks of Nn
+ * consecutive nodes, where each block is one particle. At each time
+ * in tspan with observations, the particles are weighted with the
+ * likelihood of the observations, and then resampled by copying the
+ * state of the nodes between the blocks.
+ */
+typedef struct SimInf_pfilter
+{
+    /*** Constants ***/
+    int Npart;                /**< Number of particles. */
+    int Nn;                   /**< Number of nodes in each
+                               *   particle. */
+    int Nobs;                 /**< Number of observations. */
+    const int *obs_time;      /**< Index (zero-based) in tspan of
+                               *   each observation. Sorted in
+                               *   increasing order. */
+    const int *obs_node;      /**< The node (zero-based) within the
+                               *   particle of each observation, or
+                               *   -1 to observe the sum over all
+                               *   nodes in the particle. */
+    const int *obs_value;     /**< The observed value. */
+    int dist;                 /**< The observation distribution. */
+    double p;                 /**< The parameter of the observation
+                               *   distribution: the scale of the
+                               *   mean (Poisson) or the probability
+                               *   of success (binomial). */
+    const int *compartments;  /**< The compartments (zero-based) that
+                               *   are summed to the observed
+                               *   quantity. */
+    int Ncompartments;        /**< Number of observed
+                               *   compartments. */
+
+    /*** State ***/
+    int tspan_it;             /**< Index to the next time in tspan to
+                               *   filter. */
+    int obs_it;               /**< Index to the next observation. */
+
+    /*** Result ***/
+    double loglik;            /**< The log-likelihood estimate. */
+    double *ess;              /**< The effective sample size at each
+                               *   time in tspan. Unchanged for times
+                               *   without observations. */
+} SimInf_pfilter;
+
+/**
+ * Structure with data for the group-level state.
+ *
+ * The nodes are divided into Ng groups, and the group state is the
+ * sum of a compartment or a continuous state variable over the
+ * nodes in the group. The group state is computed once per time
+ * step and is written to the local data 'ldata' of each node in the
+ * group, where it is available to the transition rate functions and
+ * the post time step function.
+ */
+typedef struct SimInf_groups
+{
+    int Ng;            /**< Number of groups. */
+    const int *jc;     /**< Index to the first node of group k in
+                        *   'ir'. Length Ng + 1. */
+    const int *ir;     /**< The nodes (zero-based) sorted by group. */
+    int Nrow;          /**< Number of group states. */
+    const int *row;    /**< The row (zero-based) in 'ldata' of each
+                        *   group state. */
+    const int *state;  /**< The state (zero-based) that is summed in
+                        *   each group state: a compartment if less
+                        *   than Nc, else the continuous state
+                        *   variable (state - Nc). */
+    double *ldata;     /**< The local data of all nodes. */
+} SimInf_groups;
+
 /* Structure to hold data/arguments to a SimInf solver.
  *
  * G is a sparse matrix dependency graph (Nt X Nt) in compressed
@@ -205,6 +414,14 @@ typedef struct SimInf_solver_args
      * internal and external transfer event. */
     const int *shift;
 
+    /* The period of a recurring event i, or 0 if the event occurs
+     * once. NULL if there are no recurring events. */
+    const int *period;
+
+    /* The last time that a recurring event i can occur. NULL if
+     * there are no recurring events. */
+    const int *end;
+
     /* Number of threads to use during simulation. */
     int Nthread;
 
@@ -217,6 +434,51 @@ typedef struct SimInf_solver_args
     /* Function pointer to callback after each time step e.g. to
      * update the infectious pressure. */
     PTSFun pts_fun;
+
+    /* Log the number of sampled individuals in each compartment when
+     * processing the scheduled events if non-zero. */
+    int log_outcomes;
+
+    /* The log of event outcomes from all threads, in the order that
+     * the events were processed. Allocated by the solver if 'log_outcomes' is
+     * non-zero, and must be freed by the caller. */
+    SimInf_event_outcome *outcomes;
+
+    /* The number of records in 'outcomes'. */
+    size_t n_outcomes;
+
+    /* Data for the bootstrap particle filter, or NULL to run the
+     * model without filtering. */
+    SimInf_pfilter *pfilter;
+
+    /* Data for the group-level state, or NULL to run the model
+     * without groups. */
+    SimInf_groups *groups;
+
+    /* Vector of length Nn where a non-zero value indicates a
+     * sentinel node where every transition is recorded, or NULL to
+     * not record transitions. */
+    const int *sentinel;
+
+    /* The transitions in the sentinel nodes from all threads, sorted
+     * by time and node. Allocated by the solver if 'sentinel' is
+     * non-NULL, and must be freed by the caller. */
+    SimInf_transition_record *transitions;
+
+    /* The number of records in 'transitions'. */
+    size_t n_transitions;
+
+    /* Vector of length Nthread with a trace buffer for each thread,
+     * or NULL to run the model without tracing. */
+    SimInf_trace *trace;
+
+    /* Vector of length Nn with the cost counters of each node, or
+     * NULL to run the model without profiling. */
+    SimInf_node_profile *profile;
+
+    /* Write the dense U and V compartment-major if non-zero, i.e.,
+     * row c * Nn + node instead of node * Nc + c. */
+    int compartment_major;
 } SimInf_solver_args;
 
 /**
@@ -226,7 +488,9 @@ typedef struct SimInf_scheduled_event
 {
     int event;         /**< The type of the event. */
     int time;          /**< The time for the event. */
-    int node;          /**< The source node of the event. */
+    int node;          /**< The source node of the event, or -1
+                        *   for an internal transfer event that
+                        *   is applied to all nodes. */
     int dest;          /**< The dest node of the event. */
     int n;             /**< The number of individuals in the scheduled
                         *   event. n >= 0. */
@@ -241,6 +505,8 @@ typedef struct SimInf_scheduled_event
     int shift;         /**< Column j in the shift matrix that
                         *   determines the shift of the internal
                         *   and external transfer event. */
+    int id;            /**< The index of the event in the scheduled
+                        *   events. */
 } SimInf_scheduled_event;
 
 typedef kvec_t(SimInf_scheduled_event) SimInf_events_t;
@@ -268,12 +534,29 @@ typedef struct SimInf_scheduled_events
     size_t events_index;    /**< Index to the next event to
                              *   process. */
 
+    /*** Recurring events ***/
+    const int *period;      /**< The period of each scheduled event,
+                             *   or NULL if there are no recurring
+                             *   events. */
+    const int *end;         /**< The last time of each recurring
+                             *   event. */
+    SimInf_events_t recurring; /**< Binary heap with the next
+                                *   occurrence of the recurring
+                                *   events, ordered by time. */
+
     /*** Vectors for sampling individuals ***/
     int *individuals;     /**< Vector to store the result of the
                            *   sampling during scheduled events
                            *   processing. */
     gsl_rng *rng;         /**< The random number generator for
                            *   sampling. */
+
+    /*** Log of event outcomes ***/
+    int log_outcomes;     /**< Log the sampled individuals if
+                           *   non-zero. */
+    SimInf_event_outcomes_t outcomes; /**< The log of the sampled
+                                       *   individuals for the events
+                                       *   processed by the thread. */
 } SimInf_scheduled_events;
 
 /**
@@ -293,6 +576,12 @@ typedef struct SimInf_compartment_model
     int Nld;   /**< Length of the local data vector 'ldata' for each
                 *   node. The 'ldata' vector is sent to propensities
                 *   and the post time step function. */
+    int Nblock; /**< Number of nodes in each block of replicated
+                 *   nodes, e.g. a particle in the particle filter.
+                 *   The node index passed to the post time step
+                 *   function is relative to the first node in the
+                 *   block. Equals Ntot if the nodes are not
+                 *   replicated. */
 
     /*** Sparse matrices ***/
     const int *irG; /**< Dependency graph. irG[k] is the row of
@@ -321,6 +610,8 @@ typedef struct SimInf_compartment_model
     int tlen;            /**< Number of sampling points in time. */
     int U_it;            /**< Index to next time in tspan */
     int V_it;            /**< Index to next time in tspan */
+    int compartment_major; /**< Write the dense U and V
+                            *   compartment-major if non-zero. */
 
     /*** Data vectors ***/
     int *u;           /**< Vector with the number of individuals in
@@ -360,10 +651,23 @@ typedef struct SimInf_compartment_model
     const double *gdata; /**< The global data vector. */
     int *update_node; /**< Vector of length Nn used to indicate nodes
                        *   for update. */
+    SimInf_groups *groups; /**< The group-level state, or NULL. */
+    const int *sentinel; /**< Vector of length Nn where a non-zero
+                          *   value indicates that transitions in the
+                          *   node are recorded, or NULL. */
+    SimInf_transition_records_t transitions; /**< The transitions
+                                              *   in the sentinel
+                                              *   nodes of the
+                                              *   thread. */
+    SimInf_trace *trace; /**< Vector of length Nthread with a trace
+                          *   buffer for each thread, or NULL. */
+    SimInf_node_profile *profile; /**< Vector of length Nn with the
+                                   *   cost counters of each node,
+                                   *   or NULL. */
 
     double *sum_t_rate; /**< Vector of length Nn with the sum of
                          *   propensities in every node. */
-    double *t_rate;     /**< Transition rate matrix (Nt X Nn) with all
+    SimInf_rate_t *t_rate; /**< Transition rate matrix (Nt X Nn) with all
                          *   propensities for state transitions. */
     double *t_time;     /**< Time for next event (transition) in each
                          *   node. */
@@ -377,19 +681,179 @@ int SimInf_compartment_model_create(
 void SimInf_compartment_model_free(
     SimInf_compartment_model *model);
 
+int SimInf_compartment_model_transitions(
+    SimInf_solver_args *args,
+    const SimInf_compartment_model *model);
+
+/**
+ * Record a transition in a sentinel node.
+ *
+ * @param m The compartment model data for the thread.
+ * @param node The node (zero-based) in the thread.
+ * @param tr The transition (zero-based) that occurred.
+ */
+static inline void SimInf_record_transition(
+    SimInf_compartment_model *m,
+    const int node,
+    const int tr)
+{
+    if (m->sentinel && m->sentinel[node]) {
+        SimInf_transition_record r = {m->t_time[node], m->Ni + node, tr};
+        kv_push(SimInf_transition_record, m->transitions, r);
+    }
+}
+
+/**
+ * Get the wall-clock time to trace a phase.
+ *
+ * @param trace The trace buffers, or NULL if tracing is disabled.
+ * @return The wall-clock time in seconds, or 0 if tracing is
+ *         disabled.
+ */
+static inline double SimInf_trace_clock(const SimInf_trace *trace)
+{
+    if (!trace)
+        return 0.0;
+
+    #ifdef _OPENMP
+    return omp_get_wtime();
+    #else
+    return (double)clock() / CLOCKS_PER_SEC;
+    #endif
+}
+
+/**
+ * Record a phase that ends now in the trace buffer of the calling
+ * thread.
+ *
+ * @param trace The trace buffers, or NULL if tracing is disabled.
+ * @param phase The traced phase.
+ * @param time The time in the simulation when the time step started.
+ * @param begin The wall-clock time when the phase began, see
+ *        SimInf_trace_clock.
+ */
+static inline void SimInf_trace_phase(
+    SimInf_trace *trace,
+    const int phase,
+    const double time,
+    const double begin)
+{
+    if (trace) {
+        SimInf_trace *t = trace;
+        SimInf_trace_record *r;
+
+        #ifdef _OPENMP
+        t = &trace[omp_get_thread_num()];
+        #endif
+
+        r = &t->records[t->n++ % t->capacity];
+        r->phase = phase;
+        r->time = time;
+        r->begin = begin;
+        r->end = SimInf_trace_clock(trace);
+    }
+}
+
+/**
+ * Read the processor cycle counter to profile the cost of a node.
+ *
+ * @param m The compartment model data for the thread.
+ * @return The cycle counter, or 0 if profiling is disabled.
+ */
+static inline unsigned long long SimInf_profile_cycles(
+    const SimInf_compartment_model *m)
+{
+    if (!m->profile)
+        return 0;
+
+    #if SIMINF_HAVE_CYCLES
+    return __builtin_ia32_rdtsc();
+    #else
+    return 0;
+    #endif
+}
+
+/**
+ * Add the processor cycles since 'start' to the cost of a node.
+ *
+ * @param m The compartment model data for the thread.
+ * @param node The node (zero-based) in the thread.
+ * @param start The cycle counter when the work in the node started,
+ *        see SimInf_profile_cycles.
+ */
+static inline void SimInf_profile_elapsed(
+    SimInf_compartment_model *m,
+    const int node,
+    const unsigned long long start)
+{
+    if (m->profile)
+        m->profile[node].cycles += SimInf_profile_cycles(m) - start;
+}
+
+/**
+ * Count evaluated transition rates in a node.
+ *
+ * @param m The compartment model data for the thread.
+ * @param node The node (zero-based) in the thread.
+ * @param n The number of evaluated rates.
+ */
+static inline void SimInf_profile_rates(
+    SimInf_compartment_model *m,
+    const int node,
+    const int n)
+{
+    if (m->profile)
+        m->profile[node].rate_evaluations += n;
+}
+
+/**
+ * Count a transition in a node.
+ *
+ * @param m The compartment model data for the thread.
+ * @param node The node (zero-based) in the thread.
+ */
+static inline void SimInf_profile_transition(
+    SimInf_compartment_model *m,
+    const int node)
+{
+    if (m->profile)
+        m->profile[node].transitions += 1.0;
+}
+
 int SimInf_scheduled_events_create(
     SimInf_scheduled_events **out, SimInf_solver_args *args, gsl_rng *rng);
 
 void SimInf_scheduled_events_free(
     SimInf_scheduled_events *events);
 
+int SimInf_scheduled_events_outcomes(
+    SimInf_solver_args *args,
+    const SimInf_scheduled_events *events);
+
 void SimInf_process_events(
     SimInf_compartment_model *model,
     SimInf_scheduled_events *events,
     int process_E2);
 
+void SimInf_init_rates(SimInf_compartment_model *m);
+
+void SimInf_store_solution_dense(SimInf_compartment_model *model);
+
 void SimInf_store_solution_sparse(SimInf_compartment_model *model);
 
+void SimInf_groups_update(SimInf_compartment_model *model);
+
+int SimInf_probe_dependency_graph(
+    const SimInf_solver_args *args,
+    const int n,
+    int *G,
+    double *rate);
+
+int SimInf_pfilter_update(
+    SimInf_pfilter *pfilter,
+    SimInf_compartment_model *model,
+    gsl_rng *rng);
+
 void SimInf_print_status(
     const int Nc,
     const int *u,
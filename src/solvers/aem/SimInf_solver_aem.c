@@ -80,6 +80,183 @@ calcTimes(double* time, double* infTime, double tt, double old_rate,
     }
 }
 
+/**
+ * Handle the internal epidemiological model, i.e., the
+ * continuous-time Markov chain, in every node of a thread until the
+ * next unit of time.
+ *
+ * @param sa The compartment model data of the thread.
+ * @param ma The AEM solver data of the thread.
+ */
+static void SIMINF_TARGET_CLONES
+SimInf_aem_transitions(
+    SimInf_compartment_model *sa,
+    SimInf_aem_arguments *ma)
+{
+    int node;
+
+    for (node = 0; node < sa->Nn && !sa->error; node++) {
+        const unsigned long long cycles = SimInf_profile_cycles(sa);
+
+        for (;;) {
+            int ii,j,tr;
+            double old_t_rate,rate;
+
+            /* 1a) Step time forward until next event */
+            sa->t_time[node] = ma->reactTimes[sa->Nt * node];
+
+            /* Break if time is past next unit of time */
+            if (isinf(sa->t_time[node]) || sa->t_time[node] >= sa->next_unit_of_time) {
+                sa->t_time[node] = sa->next_unit_of_time;
+                break;
+            }
+
+            /* 1b) Determine which transitions that occur */
+            tr = ma->reactNode[sa->Nt * node]%sa->Nt;
+
+            /* 1c) Update the state of the node */
+            for (j = sa->jcS[tr]; j < sa->jcS[tr + 1]; j++) {
+                sa->u[node * sa->Nc + sa->irS[j]] += sa->prS[j];
+                if (sa->u[node * sa->Nc + sa->irS[j]] < 0) {
+                    SimInf_print_status(sa->Nc, &sa->u[node * sa->Nc],
+                                        sa->Ni + node, sa->t_time[node],
+                                        0, tr);
+                    sa->error = SIMINF_ERR_NEGATIVE_STATE;
+                }
+            }
+            SimInf_record_transition(sa, node, tr);
+            SimInf_profile_transition(sa, node);
+
+            /* 1d) update dependent transitions events. */
+            for (ii = sa->jcG[tr]; ii < sa->jcG[tr + 1]; ii++){
+                j = sa->irG[ii];
+                if (j != tr) { /*see code underneath */
+                    old_t_rate = sa->t_rate[node * sa->Nt + j];
+                    /* const double rate */
+                    rate = (*sa->tr_fun[j])(
+                        &sa->u[node * sa->Nc], &sa->v[node * sa->Nd],
+                        &sa->ldata[node * sa->Nld], sa->gdata,
+                        sa->t_time[node]);
+
+                    sa->t_rate[node * sa->Nt + j] = rate;
+                    SimInf_profile_rates(sa, node, 1);
+
+                    if (!R_FINITE(sa->t_rate[node * sa->Nt + j]) ||
+                        sa->t_rate[node * sa->Nt + j] < 0.0) {
+                        SimInf_print_status(sa->Nc, &sa->u[node * sa->Nc],
+                                            sa->Ni + node, sa->t_time[node],
+                                            rate, j);
+                        sa->error = SIMINF_ERR_INVALID_RATE;
+                    }
+
+                    /* update times and reorder the heap */
+                    calcTimes(&ma->reactTimes[sa->Nt * node + ma->reactHeap[sa->Nt * node + j]],
+                              &ma->reactInf[sa->Nt * node + j],
+                              sa->t_time[node],
+                              old_t_rate,
+                              sa->t_rate[node * sa->Nt + j],
+                              ma->rng_vec[sa->Nt * node + j]);
+                    update(ma->reactHeap[sa->Nt * node + j], &ma->reactTimes[sa->Nt * node],
+                           &ma->reactNode[sa->Nt * node], &ma->reactHeap[sa->Nt * node], ma->reactHeapSize);
+                }
+            }
+            /* finish with j = re (the one that just happened), which need
+               not be in the dependency graph but must be updated  nevertheless */
+            j = tr;
+            old_t_rate = sa->t_rate[node * sa->Nt + j];
+            rate = (*sa->tr_fun[j])(&sa->u[node * sa->Nc], &sa->v[node * sa->Nd],
+                                    &sa->ldata[node * sa->Nld], sa->gdata,
+                                    sa->t_time[node]);
+            sa->t_rate[node * sa->Nt + j] = rate;
+            SimInf_profile_rates(sa, node, 1);
+
+            if (!R_FINITE(sa->t_rate[node * sa->Nt + j]) ||
+                sa->t_rate[node * sa->Nt + j] < 0.0) {
+                SimInf_print_status(sa->Nc, &sa->u[node * sa->Nc],
+                                    sa->Ni + node, sa->t_time[node],
+                                    rate, j);
+                sa->error = SIMINF_ERR_INVALID_RATE;
+            }
+
+            /* update times and reorder the heap */
+            calcTimes(&ma->reactTimes[sa->Nt * node + ma->reactHeap[sa->Nt * node + j]],
+                      &ma->reactInf[sa->Nt * node + j],
+                      sa->t_time[node],
+                      old_t_rate,
+                      sa->t_rate[node * sa->Nt + j],
+                      ma->rng_vec[sa->Nt * node + j]);
+            update(ma->reactHeap[sa->Nt * node + j], &ma->reactTimes[sa->Nt * node],
+                   &ma->reactNode[sa->Nt * node], &ma->reactHeap[sa->Nt * node], ma->reactHeapSize);
+
+        }
+
+        SimInf_profile_elapsed(sa, node, cycles);
+    }
+}
+
+/**
+ * Incorporate the model specific actions after each time step in
+ * every node of a thread, and update the transition rates in the
+ * nodes that are indicated for update.
+ *
+ * @param sa The compartment model data of the thread.
+ * @param ma The AEM solver data of the thread.
+ */
+static void SIMINF_TARGET_CLONES
+SimInf_aem_post_time_step(
+    SimInf_compartment_model *sa,
+    SimInf_aem_arguments *ma)
+{
+    int node;
+
+    for (node = 0; node < sa->Nn; node++) {
+        const unsigned long long cycles = SimInf_profile_cycles(sa);
+        const int rc = sa->pts_fun(
+            &sa->v_new[node * sa->Nd], &sa->u[node * sa->Nc],
+            &sa->v[node * sa->Nd], &sa->ldata[node * sa->Nld],
+            sa->gdata, sa->Ni + node, sa->tt);
+
+        if (rc < 0) {
+            sa->error = rc;
+            break;
+        } else if (rc > 0 || sa->update_node[node]) {
+            /* Update transition rates */
+            int j = 0;
+            for (; j < sa->Nt; j++) {
+                const double old = sa->t_rate[node * sa->Nt + j];
+                const double rate = (*sa->tr_fun[j])(
+                    &sa->u[node * sa->Nc], &sa->v_new[node * sa->Nd],
+                    &sa->ldata[node * sa->Nld], sa->gdata, sa->tt);
+
+                sa->t_rate[node * sa->Nt + j] = rate;
+
+                if (!R_FINITE(sa->t_rate[node * sa->Nt + j]) ||
+                    sa->t_rate[node * sa->Nt + j] < 0.0) {
+                    SimInf_print_status(sa->Nc, &sa->u[node * sa->Nc],
+                                        sa->Ni + node, sa->tt, rate, j);
+                    sa->error = SIMINF_ERR_INVALID_RATE;
+                }
+
+                /* Update times and reorder heap */
+                calcTimes(&ma->reactTimes[sa->Nt * node + ma->reactHeap[sa->Nt * node + j]],
+                          &ma->reactInf[sa->Nt * node + j],
+                          sa->t_time[node],
+                          old,
+                          sa->t_rate[node * sa->Nt + j],
+                          ma->rng_vec[sa->Nt * node + j]);
+
+                update(ma->reactHeap[sa->Nt * node + j], &ma->reactTimes[sa->Nt * node],
+                       &ma->reactNode[sa->Nt * node], &ma->reactHeap[sa->Nt * node], ma->reactHeapSize);
+            }
+            SimInf_profile_rates(sa, node, sa->Nt);
+
+            sa->update_node[node] = 0;
+        }
+
+        SimInf_profile_elapsed(sa, node, cycles);
+    }
+}
+
 /**
  * Siminf solver
  *
@@ -91,6 +268,7 @@ static int SimInf_solver_aem(
     SimInf_scheduled_events *events,
     int Nthread)
 {
+    SimInf_trace *trace = model->trace;
     int k;
 
     #ifdef _OPENMP
@@ -99,6 +277,10 @@ static int SimInf_solver_aem(
     {
         int i;
 
+        /* Initialize the group-level state in 'ldata'. */
+        if (model[0].groups)
+            SimInf_groups_update(model);
+
         #ifdef _OPENMP
         #  pragma omp for
         #endif
@@ -111,24 +293,12 @@ static int SimInf_solver_aem(
              * every node. */
 
 	    /* Calculate the propensity for every reaction*/
+            SimInf_init_rates(&sa);
 	    for (node = 0; node < sa.Nn; node++) {
                 int j;
                 for (j = 0; j < sa.Nt; j++){
-                    const double rate = (*sa.tr_fun[j])(&sa.u[node * sa.Nc],
-                                                        &sa.v[node * sa.Nd],
-                                                        &sa.ldata[node * sa.Nld],
-                                                        sa.gdata,
-                                                        sa.tt);
-                    sa.t_rate[node * sa.Nt + j] = rate;
-
-                    if (!R_FINITE(rate) || rate < 0.0) {
-                        SimInf_print_status(sa.Nc, &sa.u[node * sa.Nc],
-                                            sa.Ni + node, sa.tt, rate, j);
-                        sa.error = SIMINF_ERR_INVALID_RATE;
-                    }
-
                     /* calculate time until next transition j event */
-                    ma.reactTimes[sa.Nt*node+j] =  -log(gsl_rng_uniform_pos(ma.rng_vec[sa.Nt*node+j]))/rate + sa.tt;
+                    ma.reactTimes[sa.Nt*node+j] =  -log(gsl_rng_uniform_pos(ma.rng_vec[sa.Nt*node+j]))/sa.t_rate[node * sa.Nt + j] + sa.tt;
                     if (ma.reactTimes[sa.Nt*node+j] <= 0.0)
                         ma.reactTimes[sa.Nt*node+j] = INFINITY;
 
@@ -153,187 +323,80 @@ static int SimInf_solver_aem(
 
     /* Main loop. */
     for (;;) {
+        const double tt = model[0].tt;
+
         #ifdef _OPENMP
         #  pragma omp parallel num_threads(SimInf_num_threads())
         #endif
         {
+            double begin = SimInf_trace_clock(trace);
             int i;
 
             #ifdef _OPENMP
             #  pragma omp for
             #endif
             for (i = 0; i < Nthread; i++) {
-                int node;
                 SimInf_compartment_model sa = *&model[i];
                 SimInf_aem_arguments ma = *&method[i];
 
+                begin = SimInf_trace_clock(trace);
+
                 /* (1) Handle internal epidemiological model,
                  * continuous-time Markov chain. */
-                for (node = 0; node < sa.Nn && !sa.error; node++) {
-                    for (;;) {
-                        int ii,j,tr;
-                        double old_t_rate,rate;
-
-                        /* 1a) Step time forward until next event */
-                        sa.t_time[node] = ma.reactTimes[sa.Nt * node];
-
-                        /* Break if time is past next unit of time */
-                        if (isinf(sa.t_time[node]) || sa.t_time[node] >= sa.next_unit_of_time) {
-                            sa.t_time[node] = sa.next_unit_of_time;
-                            break;
-                        }
-
-                        /* 1b) Determine which transitions that occur */
-                        tr = ma.reactNode[sa.Nt * node]%sa.Nt;
-
-                        /* 1c) Update the state of the node */
-                        for (j = sa.jcS[tr]; j < sa.jcS[tr + 1]; j++) {
-                            sa.u[node * sa.Nc + sa.irS[j]] += sa.prS[j];
-                            if (sa.u[node * sa.Nc + sa.irS[j]] < 0) {
-                                SimInf_print_status(sa.Nc, &sa.u[node * sa.Nc],
-                                                    sa.Ni + node, sa.t_time[node],
-                                                    0, tr);
-                                sa.error = SIMINF_ERR_NEGATIVE_STATE;
-                            }
-                        }
-
-
-                        /* 1d) update dependent transitions events. */
-                        for (ii = sa.jcG[tr]; ii < sa.jcG[tr + 1]; ii++){
-                            j = sa.irG[ii];
-                            if (j != tr) { /*see code underneath */
-                                old_t_rate = sa.t_rate[node * sa.Nt + j];
-                                /* const double rate */
-                                rate = (*sa.tr_fun[j])(
-                                    &sa.u[node * sa.Nc], &sa.v[node * sa.Nd],
-                                    &sa.ldata[node * sa.Nld], sa.gdata,
-                                    sa.t_time[node]);
-
-                                sa.t_rate[node * sa.Nt + j] = rate;
-
-                                if (!R_FINITE(rate) || rate < 0.0) {
-                                    SimInf_print_status(sa.Nc, &sa.u[node * sa.Nc],
-                                                        sa.Ni + node, sa.t_time[node],
-                                                        rate, j);
-                                    sa.error = SIMINF_ERR_INVALID_RATE;
-                                }
-
-                                /* update times and reorder the heap */
-                                calcTimes(&ma.reactTimes[sa.Nt * node + ma.reactHeap[sa.Nt * node + j]],
-                                          &ma.reactInf[sa.Nt * node + j],
-                                          sa.t_time[node],
-                                          old_t_rate,
-                                          sa.t_rate[node * sa.Nt + j],
-                                          ma.rng_vec[sa.Nt * node + j]);
-                                update(ma.reactHeap[sa.Nt * node + j], &ma.reactTimes[sa.Nt * node],
-                                       &ma.reactNode[sa.Nt * node], &ma.reactHeap[sa.Nt * node], ma.reactHeapSize);
-                            }
-                        }
-                        /* finish with j = re (the one that just happened), which need
-                           not be in the dependency graph but must be updated  nevertheless */
-                        j = tr;
-                        old_t_rate = sa.t_rate[node * sa.Nt + j];
-                        rate = (*sa.tr_fun[j])(&sa.u[node * sa.Nc], &sa.v[node * sa.Nd],
-                                               &sa.ldata[node * sa.Nld], sa.gdata,
-                                               sa.t_time[node]);
-                        sa.t_rate[node * sa.Nt + j] = rate;
-
-                        if (!R_FINITE(rate) || rate < 0.0) {
-                            SimInf_print_status(sa.Nc, &sa.u[node * sa.Nc],
-                                                sa.Ni + node, sa.t_time[node],
-                                                rate, j);
-                            sa.error = SIMINF_ERR_INVALID_RATE;
-                        }
-
-                        /* update times and reorder the heap */
-                        calcTimes(&ma.reactTimes[sa.Nt * node + ma.reactHeap[sa.Nt * node + j]],
-                                  &ma.reactInf[sa.Nt * node + j],
-                                  sa.t_time[node],
-                                  old_t_rate,
-                                  sa.t_rate[node * sa.Nt + j],
-                                  ma.rng_vec[sa.Nt * node + j]);
-                        update(ma.reactHeap[sa.Nt * node + j], &ma.reactTimes[sa.Nt * node],
-                               &ma.reactNode[sa.Nt * node], &ma.reactHeap[sa.Nt * node], ma.reactHeapSize);
-
-                    }
-                }
+                SimInf_aem_transitions(&sa, &ma);
 
                 *&model[i] = sa;
                 *&method[i] = ma;
+                SimInf_trace_phase(trace, SIMINF_TRACE_TRANSITIONS, tt, begin);
 
                 /* (2) Incorporate all scheduled E1 events */
+                begin = SimInf_trace_clock(trace);
                 SimInf_process_events(&model[i], &events[i], 0);
+                SimInf_trace_phase(trace, SIMINF_TRACE_E1, tt, begin);
+                begin = SimInf_trace_clock(trace);
 	    }
 
             #ifdef _OPENMP
             #  pragma omp barrier
             #endif
+            SimInf_trace_phase(trace, SIMINF_TRACE_WAIT, tt, begin);
 
             #ifdef _OPENMP
             #  pragma omp master
             #endif
             {
                 /* (3) Incorporate all scheduled E2 events */
+                begin = SimInf_trace_clock(trace);
                 SimInf_process_events(model, events, 1);
+                SimInf_trace_phase(trace, SIMINF_TRACE_E2, tt, begin);
             }
 
+            begin = SimInf_trace_clock(trace);
             #ifdef _OPENMP
             #  pragma omp barrier
             #endif
+            SimInf_trace_phase(trace, SIMINF_TRACE_WAIT, tt, begin);
+
+            /* (3b) Update the group-level state in 'ldata' after the
+             * scheduled events. */
+            if (model[0].groups)
+                SimInf_groups_update(model);
 
             #ifdef _OPENMP
             #  pragma omp for
             #endif
             for (i = 0; i < Nthread; i++) {
-                int node;
                 SimInf_compartment_model sa = *&model[i];
                 SimInf_aem_arguments ma = *&method[i];
 
+                begin = SimInf_trace_clock(trace);
+
                 /* (4) Incorporate model specific actions after each
                  * timestep e.g. update the infectious pressure
                  * variable. Moreover, update transition rates in
                  * nodes that are indicated for update */
-                for (node = 0; node < sa.Nn; node++) {
-                    const int rc = sa.pts_fun(
-                        &sa.v_new[node * sa.Nd], &sa.u[node * sa.Nc],
-                        &sa.v[node * sa.Nd], &sa.ldata[node * sa.Nld],
-                        sa.gdata, sa.Ni + node, sa.tt);
-
-                    if (rc < 0) {
-                        sa.error = rc;
-                        break;
-                    } else if (rc > 0 || sa.update_node[node]) {
-                        /* Update transition rates */
-                        int j = 0;
-                        for (; j < sa.Nt; j++) {
-                            const double old = sa.t_rate[node * sa.Nt + j];
-                            const double rate = (*sa.tr_fun[j])(
-                                &sa.u[node * sa.Nc], &sa.v_new[node * sa.Nd],
-                                &sa.ldata[node * sa.Nld], sa.gdata, sa.tt);
-
-                            sa.t_rate[node * sa.Nt + j] = rate;
-
-                            if (!R_FINITE(rate) || rate < 0.0) {
-                                SimInf_print_status(sa.Nc, &sa.u[node * sa.Nc],
-                                                    sa.Ni + node, sa.tt, rate, j);
-                                sa.error = SIMINF_ERR_INVALID_RATE;
-                            }
-
-			    /* Update times and reorder heap */
-			    calcTimes(&ma.reactTimes[sa.Nt * node + ma.reactHeap[sa.Nt * node + j]],
-				      &ma.reactInf[sa.Nt * node + j],
-				      sa.t_time[node],
-				      old,
-				      sa.t_rate[node * sa.Nt + j],
-				      ma.rng_vec[sa.Nt * node + j]);
-
-			    update(ma.reactHeap[sa.Nt * node + j], &ma.reactTimes[sa.Nt * node],
-                                   &ma.reactNode[sa.Nt * node], &ma.reactHeap[sa.Nt * node], ma.reactHeapSize);
-                        }
-
-                        sa.update_node[node] = 0;
-                    }
-                }
+                SimInf_aem_post_time_step(&sa, &ma);
+                SimInf_trace_phase(trace, SIMINF_TRACE_PTS, tt, begin);
 
                 /* (5) The global time now equals next unit of time. */
                 sa.tt = sa.next_unit_of_time;
@@ -348,14 +411,9 @@ static int SimInf_solver_aem(
                  * outside the 'pragma omp parallel' statement (6b). */
                 /* 6a) Handle the case where the solution is stored in
                  * a dense matrix */
-                /* Copy compartment state to U */
-                while (sa.U && sa.U_it < sa.tlen && sa.tt > sa.tspan[sa.U_it])
-                    memcpy(&sa.U[sa.Nc * ((sa.Ntot * sa.U_it++) + sa.Ni)],
-                           sa.u, sa.Nn * sa.Nc * sizeof(int));
-                /* Copy continuous state to V */
-                while (sa.V && sa.V_it < sa.tlen && sa.tt > sa.tspan[sa.V_it])
-                    memcpy(&sa.V[sa.Nd * ((sa.Ntot * sa.V_it++) + sa.Ni)],
-                           sa.v_new, sa.Nn * sa.Nd * sizeof(double));
+                /* Copy compartment state to U and continuous
+                 * state to V */
+                SimInf_store_solution_dense(&sa);
 
                 *&model[i] = sa;
                 *&method[i] = ma;
@@ -531,6 +589,14 @@ int attribute_hidden SimInf_run_solver_aem(SimInf_solver_args *args)
         goto cleanup;
 
     error = SimInf_solver_aem(model, method, events, args->Nthread);
+    if (error)
+        goto cleanup;
+
+    error = SimInf_scheduled_events_outcomes(args, events);
+    if (error)
+        goto cleanup;
+
+    error = SimInf_compartment_model_transitions(args, model);
 
 cleanup:
     gsl_rng_free(rng);
@@ -31,16 +31,180 @@
 #include "misc/SimInf_openmp.h"
 #include "SimInf_solver_ssm.h"
 
+/**
+ * Handle the internal epidemiological model, i.e., the
+ * continuous-time Markov chain, in every node of a thread until the
+ * next unit of time.
+ *
+ * @param m The compartment model data of the thread.
+ * @param e The scheduled events of the thread, for the random number
+ *        generator.
+ */
+static void SIMINF_TARGET_CLONES
+SimInf_ssm_transitions(
+    SimInf_compartment_model *m,
+    SimInf_scheduled_events *e)
+{
+    int node;
+
+    for (node = 0; node < m->Nn && !m->error; node++) {
+        const unsigned long long cycles = SimInf_profile_cycles(m);
+
+        for (;;) {
+            double cum, rand, tau, delta = 0.0;
+            int j, tr;
+
+            /* 1a) Compute time to next event for this
+             * node. */
+            if (m->sum_t_rate[node] <= 0.0) {
+                m->t_time[node] = m->next_unit_of_time;
+                break;
+            }
+            tau = -log(gsl_rng_uniform_pos(e->rng)) /
+                m->sum_t_rate[node];
+            if ((tau + m->t_time[node]) >= m->next_unit_of_time) {
+                m->t_time[node] = m->next_unit_of_time;
+                break;
+            }
+            m->t_time[node] += tau;
+
+            /* 1b) Determine the transition that did occur
+             * (direct SSA). */
+            rand = gsl_rng_uniform_pos(e->rng) * m->sum_t_rate[node];
+            for (tr = 0, cum = m->t_rate[node * m->Nt];
+                 tr < m->Nt && rand > cum;
+                 tr++, cum += m->t_rate[node * m->Nt + tr]);
+
+            /* Elaborate floating point fix: */
+            if (tr >= m->Nt)
+                tr = m->Nt - 1;
+            if (m->t_rate[node * m->Nt + tr] == 0.0) {
+                /* Go backwards and try to find first
+                 * nonzero transition rate */
+                for ( ; tr > 0 && m->t_rate[node * m->Nt + tr] == 0.0; tr--);
+
+                /* No nonzero rate found, but a transition
+                   was sampled. This can happen due to
+                   floating point errors in the iterated
+                   recalculated rates. */
+                if (m->t_rate[node * m->Nt + tr] == 0.0) {
+                    /* nil event: zero out and move on */
+                    m->sum_t_rate[node] = 0.0;
+                    break;
+                }
+            }
+
+            /* 1c) Update the state of the node */
+            for (j = m->jcS[tr]; j < m->jcS[tr + 1]; j++) {
+                m->u[node * m->Nc + m->irS[j]] += m->prS[j];
+                if (m->u[node * m->Nc + m->irS[j]] < 0) {
+                    SimInf_print_status(m->Nc, &m->u[node * m->Nc],
+                                        m->Ni + node, m->t_time[node],
+                                        0, tr);
+                    m->error = SIMINF_ERR_NEGATIVE_STATE;
+                }
+            }
+            SimInf_record_transition(m, node, tr);
+            SimInf_profile_transition(m, node);
+            SimInf_profile_rates(m, node, m->jcG[tr + 1] - m->jcG[tr]);
+
+            /* 1d) Recalculate sum_t_rate[node] using
+             * dependency graph. */
+            for (j = m->jcG[tr]; j < m->jcG[tr + 1]; j++) {
+                const double old = m->t_rate[node * m->Nt + m->irG[j]];
+                const double rate = (*m->tr_fun[m->irG[j]])(
+                    &m->u[node * m->Nc], &m->v[node * m->Nd],
+                    &m->ldata[node * m->Nld], m->gdata,
+                    m->t_time[node]);
+
+                m->t_rate[node * m->Nt + m->irG[j]] = rate;
+                delta += m->t_rate[node * m->Nt + m->irG[j]] - old;
+                if (!R_FINITE(m->t_rate[node * m->Nt + m->irG[j]]) ||
+                    m->t_rate[node * m->Nt + m->irG[j]] < 0.0) {
+                    SimInf_print_status(m->Nc, &m->u[node * m->Nc],
+                                        m->Ni + node, m->t_time[node],
+                                        rate, m->irG[j]);
+                    m->error = SIMINF_ERR_INVALID_RATE;
+                }
+            }
+            m->sum_t_rate[node] += delta;
+        }
+
+        SimInf_profile_elapsed(m, node, cycles);
+    }
+}
+
+/**
+ * Incorporate the model specific actions after each time step in
+ * every node of a thread, and update the transition rates in the
+ * nodes that are indicated for update.
+ *
+ * @param m The compartment model data of the thread.
+ */
+static void SIMINF_TARGET_CLONES
+SimInf_ssm_post_time_step(
+    SimInf_compartment_model *m)
+{
+    int node;
+
+    for (node = 0; node < m->Nn; node++) {
+        const unsigned long long cycles = SimInf_profile_cycles(m);
+        const int rc = m->pts_fun(
+            &m->v_new[node * m->Nd], &m->u[node * m->Nc],
+            &m->v[node * m->Nd], &m->ldata[node * m->Nld],
+            m->gdata, (m->Ni + node) % m->Nblock, m->tt);
+
+        if (rc < 0) {
+            m->error = rc;
+            break;
+        } else if (rc > 0 || m->update_node[node]) {
+            /* Update transition rates */
+            int j = 0;
+            double delta = 0.0;
+
+            for (; j < m->Nt; j++) {
+                const double old = m->t_rate[node * m->Nt + j];
+                const double rate = (*m->tr_fun[j])(
+                    &m->u[node * m->Nc], &m->v_new[node * m->Nd],
+                    &m->ldata[node * m->Nld], m->gdata, m->tt);
+
+                m->t_rate[node * m->Nt + j] = rate;
+                delta += m->t_rate[node * m->Nt + j] - old;
+                if (!R_FINITE(m->t_rate[node * m->Nt + j]) ||
+                    m->t_rate[node * m->Nt + j] < 0.0) {
+                    SimInf_print_status(m->Nc, &m->u[node * m->Nc],
+                                        m->Ni + node, m->tt, rate, j);
+                    m->error = SIMINF_ERR_INVALID_RATE;
+                }
+            }
+            m->sum_t_rate[node] += delta;
+            SimInf_profile_rates(m, node, m->Nt);
+
+            m->update_node[node] = 0;
+        }
+
+        SimInf_profile_elapsed(m, node, cycles);
+    }
+}
+
 /**
  * Siminf solver
  *
+ * @param model The compartment model data for each thread.
+ * @param events The scheduled events for each thread.
+ * @param pfilter Data for the particle filter, or NULL to run the
+ *        model without filtering.
+ * @param rng The random number generator for resampling particles.
  * @return 0 if Ok, else error code.
  */
 static int SimInf_solver_ssm(
     SimInf_compartment_model *model,
-    SimInf_scheduled_events *events)
+    SimInf_scheduled_events *events,
+    SimInf_pfilter *pfilter,
+    gsl_rng *rng)
 {
     int Nthread = model->Nthread;
+    SimInf_trace *trace = model->trace;
     int k;
 
     #ifdef _OPENMP
@@ -49,6 +213,10 @@ static int SimInf_solver_ssm(
     {
         int i;
 
+        /* Initialize the group-level state in 'ldata'. */
+        if (model[0].groups)
+            SimInf_groups_update(model);
+
         #ifdef _OPENMP
         #  pragma omp for
         #endif
@@ -60,23 +228,13 @@ static int SimInf_solver_ssm(
              * every node. Store the sum of the transition rates in
              * each node in sum_t_rate. Moreover, initialize time in
              * each node. */
+            SimInf_init_rates(&m);
             for (node = 0; node < m.Nn; node++) {
                 int j;
 
                 m.sum_t_rate[node] = 0.0;
-                for (j = 0; j < m.Nt; j++) {
-                    const double rate = (*m.tr_fun[j])(
-                            &m.u[node * m.Nc], &m.v[node * m.Nd],
-                            &m.ldata[node * m.Nld], m.gdata, m.tt);
-
-                    m.t_rate[node * m.Nt + j] = rate;
-                    m.sum_t_rate[node] += rate;
-                    if (!R_FINITE(rate) || rate < 0.0) {
-                        SimInf_print_status(m.Nc, &m.u[node * m.Nc],
-                                            m.Ni + node, m.tt, rate, j);
-                        m.error = SIMINF_ERR_INVALID_RATE;
-                    }
-                }
+                for (j = 0; j < m.Nt; j++)
+                    m.sum_t_rate[node] += m.t_rate[node * m.Nt + j];
 
                 m.t_time[node] = m.tt;
             }
@@ -92,167 +250,79 @@ static int SimInf_solver_ssm(
 
     /* Main loop. */
     for (;;) {
+        const double tt = model[0].tt;
+
         #ifdef _OPENMP
         #  pragma omp parallel num_threads(SimInf_num_threads())
         #endif
         {
+            double begin = SimInf_trace_clock(trace);
             int i;
 
             #ifdef _OPENMP
             #  pragma omp for
             #endif
             for (i = 0; i < Nthread; i++) {
-                int node;
                 SimInf_scheduled_events e = *&events[i];
                 SimInf_compartment_model m = *&model[i];
 
+                begin = SimInf_trace_clock(trace);
+
                 /* (1) Handle internal epidemiological model,
                  * continuous-time Markov chain. */
-                for (node = 0; node < m.Nn && !m.error; node++) {
-                    for (;;) {
-                        double cum, rand, tau, delta = 0.0;
-                        int j, tr;
-
-                        /* 1a) Compute time to next event for this
-                         * node. */
-                        if (m.sum_t_rate[node] <= 0.0) {
-                            m.t_time[node] = m.next_unit_of_time;
-                            break;
-                        }
-                        tau = -log(gsl_rng_uniform_pos(e.rng)) /
-                            m.sum_t_rate[node];
-                        if ((tau + m.t_time[node]) >= m.next_unit_of_time) {
-                            m.t_time[node] = m.next_unit_of_time;
-                            break;
-                        }
-                        m.t_time[node] += tau;
-
-                        /* 1b) Determine the transition that did occur
-                         * (direct SSA). */
-                        rand = gsl_rng_uniform_pos(e.rng) * m.sum_t_rate[node];
-                        for (tr = 0, cum = m.t_rate[node * m.Nt];
-                             tr < m.Nt && rand > cum;
-                             tr++, cum += m.t_rate[node * m.Nt + tr]);
-
-                        /* Elaborate floating point fix: */
-                        if (tr >= m.Nt)
-                            tr = m.Nt - 1;
-                        if (m.t_rate[node * m.Nt + tr] == 0.0) {
-                            /* Go backwards and try to find first
-                             * nonzero transition rate */
-                            for ( ; tr > 0 && m.t_rate[node * m.Nt + tr] == 0.0; tr--);
-
-                            /* No nonzero rate found, but a transition
-                               was sampled. This can happen due to
-                               floating point errors in the iterated
-                               recalculated rates. */
-                            if (m.t_rate[node * m.Nt + tr] == 0.0) {
-                                /* nil event: zero out and move on */
-                                m.sum_t_rate[node] = 0.0;
-                                break;
-                            }
-                        }
-
-                        /* 1c) Update the state of the node */
-                        for (j = m.jcS[tr]; j < m.jcS[tr + 1]; j++) {
-                            m.u[node * m.Nc + m.irS[j]] += m.prS[j];
-                            if (m.u[node * m.Nc + m.irS[j]] < 0) {
-                                SimInf_print_status(m.Nc, &m.u[node * m.Nc],
-                                                    m.Ni + node, m.t_time[node],
-                                                    0, tr);
-                                m.error = SIMINF_ERR_NEGATIVE_STATE;
-                            }
-                        }
-
-                        /* 1d) Recalculate sum_t_rate[node] using
-                         * dependency graph. */
-                        for (j = m.jcG[tr]; j < m.jcG[tr + 1]; j++) {
-                            const double old = m.t_rate[node * m.Nt + m.irG[j]];
-                            const double rate = (*m.tr_fun[m.irG[j]])(
-                                &m.u[node * m.Nc], &m.v[node * m.Nd],
-                                &m.ldata[node * m.Nld], m.gdata,
-                                m.t_time[node]);
-
-                            m.t_rate[node * m.Nt + m.irG[j]] = rate;
-                            delta += rate - old;
-                            if (!R_FINITE(rate) || rate < 0.0) {
-                                SimInf_print_status(m.Nc, &m.u[node * m.Nc],
-                                                    m.Ni + node, m.t_time[node],
-                                                    rate, m.irG[j]);
-                                m.error = SIMINF_ERR_INVALID_RATE;
-                            }
-                        }
-                        m.sum_t_rate[node] += delta;
-                    }
-                }
+                SimInf_ssm_transitions(&m, &e);
 
                 *&events[i] = e;
                 *&model[i] = m;
+                SimInf_trace_phase(trace, SIMINF_TRACE_TRANSITIONS, tt, begin);
 
                 /* (2) Incorporate all scheduled E1 events */
+                begin = SimInf_trace_clock(trace);
                 SimInf_process_events(&model[i], &events[i], 0);
+                SimInf_trace_phase(trace, SIMINF_TRACE_E1, tt, begin);
+                begin = SimInf_trace_clock(trace);
             }
 
             #ifdef _OPENMP
             #  pragma omp barrier
             #endif
+            SimInf_trace_phase(trace, SIMINF_TRACE_WAIT, tt, begin);
 
             #ifdef _OPENMP
             #  pragma omp master
             #endif
             {
                 /* (3) Incorporate all scheduled E2 events */
+                begin = SimInf_trace_clock(trace);
                 SimInf_process_events(model, events, 1);
+                SimInf_trace_phase(trace, SIMINF_TRACE_E2, tt, begin);
             }
 
+            begin = SimInf_trace_clock(trace);
             #ifdef _OPENMP
             #  pragma omp barrier
             #endif
+            SimInf_trace_phase(trace, SIMINF_TRACE_WAIT, tt, begin);
+
+            /* (3b) Update the group-level state in 'ldata' after the
+             * scheduled events. */
+            if (model[0].groups)
+                SimInf_groups_update(model);
 
             #ifdef _OPENMP
             #  pragma omp for
             #endif
             for (i = 0; i < Nthread; i++) {
-                int node;
                 SimInf_compartment_model m = *&model[i];
 
+                begin = SimInf_trace_clock(trace);
+
                 /* (4) Incorporate model specific actions after each
                  * timestep e.g. update the infectious pressure
                  * variable. Moreover, update transition rates in
                  * nodes that are indicated for update */
-                for (node = 0; node < m.Nn; node++) {
-                    const int rc = m.pts_fun(
-                        &m.v_new[node * m.Nd], &m.u[node * m.Nc],
-                        &m.v[node * m.Nd], &m.ldata[node * m.Nld],
-                        m.gdata, m.Ni + node, m.tt);
-
-                    if (rc < 0) {
-                        m.error = rc;
-                        break;
-                    } else if (rc > 0 || m.update_node[node]) {
-                        /* Update transition rates */
-                        int j = 0;
-                        double delta = 0.0;
-
-                        for (; j < m.Nt; j++) {
-                            const double old = m.t_rate[node * m.Nt + j];
-                            const double rate = (*m.tr_fun[j])(
-                                &m.u[node * m.Nc], &m.v_new[node * m.Nd],
-                                &m.ldata[node * m.Nld], m.gdata, m.tt);
-
-                            m.t_rate[node * m.Nt + j] = rate;
-                            delta += rate - old;
-                            if (!R_FINITE(rate) || rate < 0.0) {
-                                SimInf_print_status(m.Nc, &m.u[node * m.Nc],
-                                                    m.Ni + node, m.tt, rate, j);
-                                m.error = SIMINF_ERR_INVALID_RATE;
-                            }
-                        }
-                        m.sum_t_rate[node] += delta;
-
-                        m.update_node[node] = 0;
-                    }
-                }
+                SimInf_ssm_post_time_step(&m);
+                SimInf_trace_phase(trace, SIMINF_TRACE_PTS, tt, begin);
 
                 /* (5) The global time now equals next unit of time. */
                 m.tt = m.next_unit_of_time;
@@ -267,14 +337,9 @@ static int SimInf_solver_ssm(
                  * outside the 'pragma omp parallel' statement (6b). */
                 /* 6a) Handle the case where the solution is stored in
                  * a dense matrix */
-                /* Copy compartment state to U */
-                while (m.U && m.U_it < m.tlen && m.tt > m.tspan[m.U_it])
-                    memcpy(&m.U[m.Nc * ((m.Ntot * m.U_it++) + m.Ni)],
-                           m.u, m.Nn * m.Nc * sizeof(int));
-                /* Copy continuous state to V */
-                while (m.V && m.V_it < m.tlen && m.tt > m.tspan[m.V_it])
-                    memcpy(&m.V[m.Nd * ((m.Ntot * m.V_it++) + m.Ni)],
-                           m.v_new, m.Nn * m.Nd * sizeof(double));
+                /* Copy compartment state to U and continuous
+                 * state to V */
+                SimInf_store_solution_dense(&m);
 
                 *&model[i] = m;
             }
@@ -294,6 +359,17 @@ static int SimInf_solver_ssm(
                 return model[k].error;
         }
 
+        /* (7) Weight and resample the particles if tt has passed a
+         * time in tspan with observations. Stop the simulation if
+         * no particle is compatible with the observations. */
+        if (pfilter) {
+            const int rc = SimInf_pfilter_update(pfilter, model, rng);
+            if (rc < 0)
+                return rc;
+            else if (rc > 0)
+                break;
+        }
+
         /* If the simulation has reached the final time, exit. */
         if (model[0].U_it >= model[0].tlen)
             break;
@@ -330,7 +406,15 @@ int attribute_hidden SimInf_run_solver_ssm(SimInf_solver_args *args)
     if (error)
         goto cleanup;
 
-    error = SimInf_solver_ssm(model, events);
+    error = SimInf_solver_ssm(model, events, args->pfilter, rng);
+    if (error)
+        goto cleanup;
+
+    error = SimInf_scheduled_events_outcomes(args, events);
+    if (error)
+        goto cleanup;
+
+    error = SimInf_compartment_model_transitions(args, model);
 
 cleanup:
     gsl_rng_free(rng);